@@ -1,4 +1,3 @@
-#include <cctype>
 #include <cstring>
 #include <fstream>
 #include <giomm.h>
@@ -8,6 +7,7 @@
 using namespace AhoViewer;
 
 #include "config.h"
+#include "formats.h"
 #include "tempdir.h"
 #ifdef HAVE_LIBUNRAR
 #include "rar.h"
@@ -52,14 +52,7 @@ bool Archive::is_valid(const Glib::ustring &path)
 
 bool Archive::is_valid_extension(const Glib::ustring &path)
 {
-    std::string ext = path.substr(path.find_last_of('.') + 1);
-    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-
-    for (const std::string &e : FileExtensions)
-        if (ext == e)
-            return true;
-
-    return false;
+    return Formats::get_instance().is_archive(path);
 }
 
 std::unique_ptr<Archive> Archive::create(const Glib::ustring &path, const Glib::ustring &parentDir)
@@ -31,7 +31,8 @@ namespace AhoViewer
             Image(const std::string &file, const Archive &archive);
             virtual std::string get_filename() const override;
             virtual const Glib::RefPtr<Gdk::Pixbuf>& get_thumbnail() override;
-            virtual void load_pixbuf() override;
+            virtual void load_pixbuf(const SizeFunc &decodeSize,
+                                     const Glib::RefPtr<Gio::Cancellable> &cancellable) override;
 
             void save(const std::string &path);
         private:
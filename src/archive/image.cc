@@ -19,7 +19,7 @@ std::string Archive::Image::get_filename() const
 
 const Glib::RefPtr<Gdk::Pixbuf>& Archive::Image::get_thumbnail()
 {
-    if (!m_ThumbnailPixbuf)
+    if (!m_ThumbnailPixbuf && !restore_thumbnail())
     {
         extract_file();
         create_thumbnail();
@@ -28,20 +28,27 @@ const Glib::RefPtr<Gdk::Pixbuf>& Archive::Image::get_thumbnail()
     return m_ThumbnailPixbuf;
 }
 
-void Archive::Image::load_pixbuf()
+void Archive::Image::load_pixbuf(const SizeFunc &decodeSize, const Glib::RefPtr<Gio::Cancellable> &cancellable)
 {
-    if (!m_Pixbuf)
+    extract_file();
+
+    bool changed = !is_webm() && decode_file(decodeSize, cancellable);
+
+    if (cancellable && cancellable->is_cancelled())
+    {
+        if (changed)
+            emit_pixbuf_changed();
+        return;
+    }
+
+    if (m_Loading)
     {
-        extract_file();
-        if (!m_isWebM)
-        {
-            Glib::RefPtr<Gdk::PixbufAnimation> p = Gdk::PixbufAnimation::create_from_file(m_Path);
-            Glib::Threads::Mutex::Lock lock(m_Mutex);
-            m_Pixbuf = p;
-        }
         m_Loading = false;
-        m_SignalPixbufChanged();
+        changed = true;
     }
+
+    if (changed)
+        emit_pixbuf_changed();
 }
 
 void Archive::Image::save(const std::string &path)
@@ -4,81 +4,85 @@
 #include "zip.h"
 using namespace AhoViewer;
 
-#include <fstream>
 #include <iostream>
 #include <zip.h>
 
 const char Zip::Magic[Zip::MagicSize] = { 'P', 'K', 0x03, 0x04 };
 
 Zip::Zip(const Glib::ustring &path, const Glib::ustring &exDir)
-  : Archive::Archive(path, exDir)
+  : Archive::Archive(path, exDir),
+    m_EntriesRead(false)
 {
 
 }
 
+Zip::~Zip()
+{
+    for (struct zip *handle : m_Handles)
+        zip_close(handle);
+}
+
 bool Zip::extract(const Glib::ustring &file) const
 {
-    bool found = false;
-    zip *zip = zip_open(m_Path.c_str(), 0, NULL);
+    if (!read_entries())
+        return false;
 
-    if (zip)
-    {
-        for (size_t i = 0, n = zip_get_num_entries(zip, 0); i < n; ++i)
-        {
-            struct zip_stat st;
-            zip_stat_init(&st);
+    // Never changes once the entries are read
+    auto it = m_Indices.find(file);
+    if (it == m_Indices.end())
+        return false;
 
-            if (zip_stat_index(zip, i, 0, &st) == -1)
-            {
-                std::cerr << "zip_stat_index: Failed to stat file #" << i
-                          << " in '" + m_Path + "'" << std::endl;
-                break;
-            }
+    struct zip *handle = take_handle();
+    if (!handle)
+        return false;
 
-            if (st.name == file)
-            {
-                Glib::ustring fPath = Glib::build_filename(m_ExtractedPath, st.name);
+    const size_t i = it->second;
+    bool found = false;
+    struct zip_stat st;
+    zip_stat_init(&st);
 
-                if (!Glib::file_test(Glib::path_get_dirname(fPath), Glib::FILE_TEST_EXISTS))
-                    g_mkdir_with_parents(Glib::path_get_dirname(fPath).c_str(), 0755);
+    if (zip_stat_index(handle, i, 0, &st) == -1)
+    {
+        std::cerr << "zip_stat_index: Failed to stat file #" << i
+                  << " in '" + m_Path + "'" << std::endl;
+    }
+    else
+    {
+        Glib::ustring fPath = Glib::build_filename(m_ExtractedPath, m_Names[i]);
 
+        if (!Glib::file_test(Glib::path_get_dirname(fPath), Glib::FILE_TEST_EXISTS))
+            g_mkdir_with_parents(Glib::path_get_dirname(fPath).c_str(), 0755);
 
-                zip_file *zfile = zip_fopen_index(zip, i, 0);
-                if (!zfile)
+        zip_file *zfile = zip_fopen_index(handle, i, 0);
+        if (zfile)
+        {
+            char *buf = new char[st.size];
+            int bufSize;
+            if ((bufSize = zip_fread(zfile, buf, st.size)) != -1)
+            {
+                try
                 {
-                    std::cerr << "zip_fopen_index: Failed to open file #" << i
-                              << " (" << st.name << ") in '" + m_Path + "'" << std::endl;
-                    break;
+                    Glib::file_set_contents(fPath, buf, bufSize);
                 }
-
-                char *buf = new char[st.size];
-                int bufSize;
-                if ((bufSize = zip_fread(zfile, buf, st.size)) != -1)
+                catch(const Glib::FileError &ex)
                 {
-                    try
-                    {
-                        Glib::file_set_contents(fPath, buf, bufSize);
-                    }
-                    catch(const Glib::FileError &ex)
-                    {
-                        std::cerr << "Glib::file_set_contents: " << ex.what() << std::endl;
-                    }
+                    std::cerr << "Glib::file_set_contents: " << ex.what() << std::endl;
                 }
-
-                delete[] buf;
-                zip_fclose(zfile);
-                found = true;
-                break;
             }
-        }
 
-        zip_close(zip);
-    }
-    else
-    {
-        std::cerr << "zip_open: Failed to open '" + m_Path + "'" << std::endl;
+            delete[] buf;
+            zip_fclose(zfile);
+            found = true;
+        }
+        else
+        {
+            std::cerr << "zip_fopen_index: Failed to open file #" << i
+                      << " (" << m_Names[i] << ") in '" + m_Path + "'" << std::endl;
+        }
     }
 
+    release_handle(handle);
+
     return found;
 }
 
@@ -90,24 +94,88 @@ bool Zip::has_valid_files(const FileType t) const
 std::vector<std::string> Zip::get_entries(const FileType t) const
 {
     std::vector<std::string> entries;
-    zip *zip = zip_open(m_Path.c_str(), 0, NULL);
 
-    if (zip)
+    if (read_entries())
     {
-        for (size_t i = 0, n = zip_get_num_entries(zip, 0); i < n; ++i)
-        {
-            struct zip_stat st;
-            zip_stat_init(&st);
+        for (const std::string &name : m_Names)
+            if (!name.empty() &&
+                 (((t & IMAGES)   && Image::is_valid_extension(name)) ||
+                  ((t & ARCHIVES) && Archive::is_valid_extension(name))))
+                entries.push_back(name);
+    }
+
+    return entries;
+}
+
+bool Zip::read_entries() const
+{
+    {
+        Glib::Threads::Mutex::Lock lock(m_Mutex);
+        if (m_EntriesRead)
+            return true;
+    }
+
+    struct zip *handle = take_handle();
+    if (!handle)
+        return false;
+
+    std::vector<std::string> names;
+    std::unordered_map<std::string, size_t> indices;
 
-            if (zip_stat_index(zip, i, 0, &st) != -1 &&
-                 (((t & IMAGES)   && Image::is_valid_extension(st.name)) ||
-                  ((t & ARCHIVES) && Archive::is_valid_extension(st.name))))
-                entries.emplace_back(st.name);
+    for (size_t i = 0, n = zip_get_num_entries(handle, 0); i < n; ++i)
+    {
+        const char *name = zip_get_name(handle, i, 0);
+
+        if (!name)
+        {
+            std::cerr << "zip_get_name: Failed to get the name of file #" << i
+                      << " in '" + m_Path + "'" << std::endl;
+            names.emplace_back();
+            continue;
         }
 
-        zip_close(zip);
+        // Like the linear search this replaced, the first entry of a name is extracted
+        names.emplace_back(name);
+        indices.emplace(names.back(), i);
     }
 
-    return entries;
+    release_handle(handle);
+
+    // Another thread could have read them meanwhile
+    Glib::Threads::Mutex::Lock lock(m_Mutex);
+    if (!m_EntriesRead)
+    {
+        m_Names.swap(names);
+        m_Indices.swap(indices);
+        m_EntriesRead = true;
+    }
+
+    return true;
+}
+
+struct zip* Zip::take_handle() const
+{
+    {
+        Glib::Threads::Mutex::Lock lock(m_Mutex);
+
+        if (!m_Handles.empty())
+        {
+            struct zip *handle = m_Handles.back();
+            m_Handles.pop_back();
+            return handle;
+        }
+    }
+
+    struct zip *handle = zip_open(m_Path.c_str(), 0, NULL);
+    if (!handle)
+        std::cerr << "zip_open: Failed to open '" + m_Path + "'" << std::endl;
+
+    return handle;
+}
+
+void Zip::release_handle(struct zip *handle) const
+{
+    Glib::Threads::Mutex::Lock lock(m_Mutex);
+    m_Handles.push_back(handle);
 }
 #endif // HAVE_LIBZIP
@@ -1,15 +1,23 @@
 #ifndef _ZIP_H_
 #define _ZIP_H_
 
+#include <unordered_map>
+#include <vector>
+
 #include "archive.h"
 
+struct zip;
+
 namespace AhoViewer
 {
+    // The central directory is read once, extract finds entries by name in a hash map.
+    // A libzip handle can only be used by one thread at a time, each extraction takes
+    // an idle handle from m_Handles and a new one is opened when they're all in use.
     class Zip : public Archive
     {
     public:
         Zip(const Glib::ustring &path, const Glib::ustring &exDir);
-        virtual ~Zip() override = default;
+        virtual ~Zip() override;
 
         virtual bool extract(const Glib::ustring &file) const override;
         virtual bool has_valid_files(const FileType t) const override;
@@ -17,6 +25,21 @@ namespace AhoViewer
 
         static const int MagicSize = 4;
         static const char Magic[MagicSize];
+    private:
+        // Reads the names of the entries the first time it's called,
+        // returns false if the archive couldn't be opened
+        bool read_entries() const;
+        // Returns nullptr if the archive couldn't be opened
+        struct zip* take_handle() const;
+        void release_handle(struct zip *handle) const;
+
+        // Entry names by index, and the first index of each name
+        mutable std::vector<std::string> m_Names;
+        mutable std::unordered_map<std::string, size_t> m_Indices;
+        mutable bool m_EntriesRead;
+
+        mutable std::vector<struct zip*> m_Handles;
+        mutable Glib::Threads::Mutex m_Mutex;
     };
 }
 
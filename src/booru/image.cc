@@ -22,10 +22,10 @@ Image::Image(const std::string &path, const std::string &url,
 {
     m_ThumbnailPath = thumbPath;
 
-    if (!m_isWebM)
+    if (!is_webm())
         m_Curler.signal_write().connect(sigc::mem_fun(*this, &Image::on_write));
 
-    if (m_isWebM && !Glib::file_test(m_Path, Glib::FILE_TEST_EXISTS))
+    if (is_webm() && !Glib::file_test(m_Path, Glib::FILE_TEST_EXISTS))
         m_Loading = true;
 
     m_Curler.set_referer(m_PostUrl);
@@ -48,9 +48,14 @@ const Glib::RefPtr<Gdk::Pixbuf>& Image::get_thumbnail()
     if (!m_ThumbnailPixbuf)
     {
         m_ThumbnailLock.writer_lock();
-        if (m_ThumbnailCurler.perform())
+        // Unloaded thumbnails are loaded again from the downloaded file
+        if (m_ThumbnailOnDisk || m_ThumbnailCurler.perform())
         {
-            m_ThumbnailCurler.save_file(m_ThumbnailPath);
+            if (!m_ThumbnailOnDisk)
+            {
+                m_ThumbnailCurler.save_file(m_ThumbnailPath);
+                m_ThumbnailOnDisk = true;
+            }
 
             try
             {
@@ -74,15 +79,25 @@ const Glib::RefPtr<Gdk::Pixbuf>& Image::get_thumbnail()
     return m_ThumbnailPixbuf;
 }
 
-void Image::load_pixbuf()
+bool Image::unload_thumbnail()
+{
+    m_ThumbnailLock.writer_lock();
+    bool kept = AhoViewer::Image::unload_thumbnail();
+    m_ThumbnailLock.writer_unlock();
+
+    return kept;
+}
+
+void Image::load_pixbuf(const SizeFunc &decodeSize, const Glib::RefPtr<Gio::Cancellable> &cancellable)
 {
-    if (!m_Pixbuf && !m_PixbufError)
+    if (!m_PixbufError)
     {
+        // Downloaded images are only decoded again if they were decoded at a reduced size
         if (Glib::file_test(m_Path, Glib::FILE_TEST_EXISTS))
         {
-            AhoViewer::Image::load_pixbuf();
+            AhoViewer::Image::load_pixbuf(decodeSize, cancellable);
         }
-        else if (!start_download() && !m_isWebM && m_Loader->get_animation())
+        else if (!m_Pixbuf && !start_download() && !is_webm() && m_Loader->get_animation())
         {
             m_Pixbuf = m_Loader->get_animation();
         }
@@ -142,7 +157,7 @@ bool Image::start_download()
         m_Page.get_image_fetcher().add_handle(&m_Curler);
         m_Loading = true;
 
-        if (!m_isWebM)
+        if (!is_webm())
         {
             m_Loader = Gdk::PixbufLoader::create();
             m_Loader->signal_area_prepared().connect(sigc::mem_fun(*this, &Image::on_area_prepared));
@@ -192,7 +207,7 @@ void Image::on_finished()
 
     m_Loading = false;
 
-    m_SignalPixbufChanged();
+    emit_pixbuf_changed();
     m_DownloadCond.signal();
 }
 
@@ -212,7 +227,7 @@ void Image::on_area_prepared()
     m_Pixbuf = m_Loader->get_animation();
 
     if (!m_Curler.is_cancelled())
-        m_SignalPixbufChanged();
+        emit_pixbuf_changed();
 }
 
 void Image::on_area_updated(int, int, int, int)
@@ -220,7 +235,7 @@ void Image::on_area_updated(int, int, int, int)
     using namespace std::chrono;
     if (!m_Curler.is_cancelled() && steady_clock::now() >= m_LastDraw + milliseconds(100))
     {
-        m_SignalPixbufChanged();
+        emit_pixbuf_changed();
         m_LastDraw = steady_clock::now();
     }
 }
@@ -28,8 +28,10 @@ namespace AhoViewer
 
             virtual std::string get_filename() const override;
             virtual const Glib::RefPtr<Gdk::Pixbuf>& get_thumbnail() override;
+            virtual bool unload_thumbnail() override;
 
-            virtual void load_pixbuf() override;
+            virtual void load_pixbuf(const SizeFunc &decodeSize,
+                                     const Glib::RefPtr<Gio::Cancellable> &cancellable) override;
             virtual void reset_pixbuf() override;
 
             void save(const std::string &path);
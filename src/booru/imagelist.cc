@@ -23,6 +23,16 @@ void ImageList::load(const xmlDocument &posts, const Page &page)
     if (!c.empty())
        m_Size = std::stoul(c);
 
+    // If thumbnails are still loading from the last page
+    // the operation needs to be cancelled, all the
+    // thumbnails will be loaded in the new thread.
+    // The workers read m_Images, it can't change until they stopped
+    if (m_ThumbnailThread)
+    {
+        m_ThumbnailCancel->cancel();
+        m_ThumbnailThread->join();
+    }
+
     for (const xmlDocument::Node &post : posts.get_children())
     {
         std::string thumbUrl  = post.get_attribute("preview_url"),
@@ -58,20 +68,13 @@ void ImageList::load(const xmlDocument &posts, const Page &page)
         m_Images.push_back(std::make_shared<Booru::Image>(imagePath, imageUrl, thumbPath, thumbUrl, postUrl, tags, page));
     }
 
-    // If thumbnails are still loading from the last page
-    // the operation needs to be cancelled, all the
-    // thumbnails will be loaded in the new thread
-    if (m_ThumbnailThread)
-    {
-        m_ThumbnailCancel->cancel();
-        m_ThumbnailThread->join();
-    }
-
-    m_ThumbnailThread = Glib::Threads::Thread::create(sigc::mem_fun(*this, &ImageList::load_thumbnails));
+    // Start from whatever the user is looking at, the new page is usually just below it
+    size_t start, end;
+    start_thumbnails(m_Widget->get_visible_range(start, end) ? start + (end - start) / 2 : m_Index);
 
     // only call set_current if this is the first page
     if (page.get_page_num() == 1)
         set_current(m_Index, false, true);
     else
-        m_SignalChanged(m_Images[m_Index]);
+        m_SignalChanged(m_Current);
 }
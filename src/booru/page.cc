@@ -57,9 +57,7 @@ Page::Page(Gtk::Menu *menu)
 
     get_vadjustment()->signal_value_changed().connect(sigc::mem_fun(*this, &Page::on_value_changed));
 
-    ModelColumns columns;
-    m_ListStore = Gtk::ListStore::create(columns);
-    m_IconView->set_model(m_ListStore);
+    m_IconView->set_model(m_Model);
     m_IconView->set_selection_mode(Gtk::SELECTION_BROWSE);
     m_IconView->set_item_width(Image::BooruThumbnailSize - m_IconView->get_margin()
                                                          - m_IconView->property_item_padding().get_value());
@@ -101,7 +99,7 @@ void Page::set_selected(const size_t index)
 {
     get_window()->freeze_updates();
 
-    Gtk::TreePath path(std::to_string(index));
+    Gtk::TreePath path = get_path(index);
     m_IconView->select_path(path);
     scroll_to_selected();
 
@@ -120,6 +118,24 @@ void Page::scroll_to_selected()
     }
 }
 
+void Page::set_model(const Glib::RefPtr<ThumbnailModel> &model)
+{
+    gtk_icon_view_set_model(m_IconView->gobj(), model ? model->Gtk::TreeModel::gobj() : nullptr);
+}
+
+bool Page::get_visible_range(size_t &start, size_t &end)
+{
+    Gtk::TreePath startPath, endPath;
+
+    if (!m_IconView->get_realized() || !m_IconView->get_visible_range(startPath, endPath))
+        return false;
+
+    start = startPath[0];
+    end = endPath[0];
+
+    return true;
+}
+
 void Page::search(const std::shared_ptr<Site> &site)
 {
     if (!ask_cancel_save())
@@ -389,6 +405,8 @@ void Page::on_value_changed()
                    get_vadjustment()->get_page_size() -
                    get_vadjustment()->get_step_increment();
 
+    m_SignalVisibleRangeChanged();
+
     if (value >= limit)
         get_next_page();
 }
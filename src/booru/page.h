@@ -37,6 +37,8 @@ namespace AhoViewer
         protected:
             virtual void set_selected(const size_t index) override;
             virtual void scroll_to_selected() override;
+            virtual bool get_visible_range(size_t &start, size_t &end) override;
+            virtual void set_model(const Glib::RefPtr<ThumbnailModel> &model) override;
         private:
             void set_tags(const std::string &tags) { m_Tags = tags; }
             void search(const std::shared_ptr<Site> &site);
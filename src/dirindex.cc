@@ -0,0 +1,249 @@
+#include <glib/gstdio.h>
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <iostream>
+
+#include "dirindex.h"
+using namespace AhoViewer;
+
+#include "settings.h"
+
+const char DirIndex::Magic[8] = { 'A', 'H', 'O', 'D', 'I', 'R', 'I', 'X' };
+std::string DirIndex::IndexDir = Glib::build_filename(Glib::get_user_cache_dir(), "ahoviewer", "directories");
+
+DirIndex::DirIndex(const std::string &dirPath)
+  : m_DirPath(dirPath),
+    m_IndexPath(Glib::build_filename(IndexDir, Glib::Checksum::compute_checksum(
+                    Glib::Checksum::CHECKSUM_MD5, dirPath) + ".index")),
+    // Taken before the directory is scanned, changes made while
+    // it's being scanned make the index out of date
+    m_DirMTime(get_dir_mtime())
+{
+
+}
+
+bool DirIndex::load()
+{
+    m_Paths.clear();
+
+    if (m_DirMTime < 0)
+        return false;
+
+    GMappedFile *file = g_mapped_file_new(m_IndexPath.c_str(), FALSE, nullptr);
+    if (!file)
+        return false;
+
+    const char *data = g_mapped_file_get_contents(file);
+    size_t length = g_mapped_file_get_length(file);
+    Header header;
+
+    bool valid = length >= sizeof(Header);
+    if (valid)
+    {
+        // The records aren't aligned, they are copied out of the mapped file
+        memcpy(&header, data, sizeof(Header));
+        valid = memcmp(header.magic, Magic, sizeof(Magic)) == 0 &&
+                header.version == Version &&
+                header.trustExtensions == Settings.get_bool("TrustExtensions") &&
+                header.dirMTime == m_DirMTime &&
+                header.dirPathLength == m_DirPath.size() &&
+                header.sampleCount == std::min(static_cast<size_t>(SampleCount), static_cast<size_t>(header.count)) &&
+                length >= sizeof(Header) + header.dirPathLength +
+                          header.sampleCount * sizeof(Sample) + header.count * sizeof(Record) &&
+                m_DirPath.compare(0, std::string::npos, data + sizeof(Header), header.dirPathLength) == 0;
+    }
+
+    std::vector<Sample> samples;
+
+    if (valid)
+    {
+        const char *sampleData = data + sizeof(Header) + header.dirPathLength,
+                   *records    = sampleData + header.sampleCount * sizeof(Sample),
+                   *names      = records + header.count * sizeof(Record);
+        size_t namesLength = data + length - names;
+
+        samples.resize(header.sampleCount);
+        memcpy(samples.data(), sampleData, header.sampleCount * sizeof(Sample));
+        m_Paths.reserve(header.count);
+
+        for (size_t i = 0; i < header.count && valid; ++i)
+        {
+            Record r;
+            memcpy(&r, records + i * sizeof(Record), sizeof(Record));
+
+            if ((valid = static_cast<size_t>(r.nameOffset) + r.nameLength <= namesLength))
+                m_Paths.push_back(Glib::build_filename(m_DirPath, std::string(names + r.nameOffset, r.nameLength)));
+        }
+    }
+
+    g_mapped_file_unref(file);
+
+    // Changing a file doesn't change the modification time of the directory,
+    // a few files spread over the list are checked instead of every file
+    for (size_t i = 0; i < samples.size() && valid; ++i)
+    {
+        const Sample &sample = samples[i];
+        guint64 size;
+        gint64 mtime;
+
+        valid = sample.index < m_Paths.size() &&
+                stat_file(m_Paths[sample.index], size, mtime) &&
+                size == sample.size && mtime == sample.mtime;
+    }
+
+    if (valid)
+    {
+        // Marks it as recently used for prune()
+        g_utime(m_IndexPath.c_str(), nullptr);
+    }
+    else
+    {
+        m_Paths.clear();
+    }
+
+    return valid;
+}
+
+void DirIndex::save(const std::vector<std::string> &paths)
+{
+    m_Paths = paths;
+
+    // The list of opened directories is kept along with the recent files
+    if (!Settings.get_bool("StoreRecentFiles"))
+        return;
+
+    std::vector<Sample> samples;
+    const size_t n = std::min(static_cast<size_t>(SampleCount), m_Paths.size());
+
+    // Only the files load() checks are stat'd
+    for (size_t i = 0; i < n; ++i)
+    {
+        Sample sample = Sample();
+        sample.index = get_sample(i, n);
+
+        if (!stat_file(m_Paths[sample.index], sample.size, sample.mtime))
+            return;
+
+        samples.push_back(sample);
+    }
+
+    write(samples);
+    prune();
+}
+
+gint64 DirIndex::get_dir_mtime() const
+{
+    try
+    {
+        Glib::RefPtr<Gio::FileInfo> info = Gio::File::create_for_path(m_DirPath)->query_info(
+                G_FILE_ATTRIBUTE_TIME_MODIFIED "," G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+        Glib::TimeVal t = info->modification_time();
+
+        return static_cast<gint64>(t.tv_sec) * G_USEC_PER_SEC + t.tv_usec;
+    }
+    catch (const Gio::Error&)
+    {
+        return -1;
+    }
+}
+
+size_t DirIndex::get_sample(const size_t i, const size_t n) const
+{
+    return n == 1 ? 0 : i * (m_Paths.size() - 1) / (n - 1);
+}
+
+bool DirIndex::stat_file(const std::string &path, guint64 &size, gint64 &mtime)
+{
+    GStatBuf st;
+
+    if (g_stat(path.c_str(), &st) != 0)
+        return false;
+
+    size  = st.st_size;
+    mtime = st.st_mtime;
+
+    return true;
+}
+
+void DirIndex::write(const std::vector<Sample> &samples)
+{
+    if (m_DirMTime < 0)
+        return;
+
+    Header header;
+    memset(&header, 0, sizeof(Header));
+    memcpy(header.magic, Magic, sizeof(Magic));
+    header.version         = Version;
+    header.trustExtensions = Settings.get_bool("TrustExtensions");
+    header.dirMTime        = m_DirMTime;
+    header.count           = m_Paths.size();
+    header.sampleCount     = samples.size();
+    header.dirPathLength   = m_DirPath.size();
+
+    std::string data(reinterpret_cast<const char*>(&header), sizeof(Header)), names;
+    data.reserve(sizeof(Header) + m_DirPath.size() + samples.size() * sizeof(Sample) +
+                 m_Paths.size() * (sizeof(Record) + 16));
+    data += m_DirPath;
+    data.append(reinterpret_cast<const char*>(samples.data()), samples.size() * sizeof(Sample));
+
+    for (const std::string &p : m_Paths)
+    {
+        std::string name = Glib::path_get_basename(p);
+        Record r;
+
+        r.nameOffset = names.size();
+        r.nameLength = name.size();
+
+        names += name;
+        data.append(reinterpret_cast<const char*>(&r), sizeof(Record));
+    }
+
+    data += names;
+
+    if (!Glib::file_test(IndexDir, Glib::FILE_TEST_EXISTS))
+        g_mkdir_with_parents(IndexDir.c_str(), 0700);
+
+    // Written to a temporary file and renamed, a reader never sees half an index
+    try
+    {
+        Glib::file_set_contents(m_IndexPath, data);
+    }
+    catch (const Glib::FileError &ex)
+    {
+        std::cerr << ex.what() << std::endl;
+    }
+}
+
+void DirIndex::prune()
+{
+    std::vector<std::pair<time_t, std::string>> files;
+
+    try
+    {
+        Glib::Dir dir(IndexDir);
+
+        for (const std::string &e : dir)
+        {
+            std::string path = Glib::build_filename(IndexDir, e);
+            GStatBuf st;
+
+            if (g_str_has_suffix(e.c_str(), ".index") && g_stat(path.c_str(), &st) == 0)
+                files.emplace_back(st.st_mtime, path);
+        }
+    }
+    catch (const Glib::FileError &ex)
+    {
+        std::cerr << ex.what() << std::endl;
+        return;
+    }
+
+    if (files.size() <= MaxIndexFiles)
+        return;
+
+    // Most recently used first
+    std::sort(files.begin(), files.end(), std::greater<std::pair<time_t, std::string>>());
+
+    for (size_t i = MaxIndexFiles; i < files.size(); ++i)
+        g_remove(files[i].second.c_str());
+}
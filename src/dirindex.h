@@ -0,0 +1,78 @@
+#ifndef _DIRINDEX_H_
+#define _DIRINDEX_H_
+
+#include <glibmm.h>
+#include <string>
+#include <vector>
+
+namespace AhoViewer
+{
+    // The sorted list of valid images in a directory, stored in the user cache dir
+    // so a directory that hasn't changed doesn't have to be scanned and sorted again.
+    // Indexes are only written when StoreRecentFiles is set, and only the
+    // MaxIndexFiles most recently used ones are kept.
+    //
+    // The file is a header followed by the sampled files, fixed size name records
+    // and the file names, it's memory mapped when read. An index is out of date when
+    // the modification time of the directory changed, or one of the sampled files changed.
+    class DirIndex
+    {
+    public:
+        DirIndex(const std::string &dirPath);
+
+        // Returns false if there is no index for the directory or it's out of date
+        bool load();
+        // Creates the index from the sorted paths of the valid images
+        void save(const std::vector<std::string> &paths);
+
+        bool empty() const { return m_Paths.empty(); }
+        std::vector<std::string> get_paths() const { return m_Paths; }
+    private:
+        struct Header
+        {
+            char magic[8];
+            guint32 version;
+            guint32 trustExtensions;
+            gint64 dirMTime;
+            guint32 count;
+            guint32 sampleCount;
+            guint32 dirPathLength;
+            guint32 padding;
+        };
+
+        // A file that is stat'd to check the index is up to date
+        struct Sample
+        {
+            guint64 size;
+            gint64 mtime;
+            guint32 index;
+            guint32 padding;
+        };
+
+        struct Record
+        {
+            guint32 nameOffset, nameLength;
+        };
+
+        // Returns -1 if the file doesn't exist
+        gint64 get_dir_mtime() const;
+        // Index of the nth of n sampled paths
+        size_t get_sample(const size_t i, const size_t n) const;
+        static bool stat_file(const std::string &path, guint64 &size, gint64 &mtime);
+        void write(const std::vector<Sample> &samples);
+        // Deletes the least recently used indexes past MaxIndexFiles
+        static void prune();
+
+        std::string m_DirPath, m_IndexPath;
+        gint64 m_DirMTime;
+        std::vector<std::string> m_Paths;
+
+        static const size_t SampleCount = 16;
+        static const size_t MaxIndexFiles = 64;
+        static const guint32 Version = 3;
+        static const char Magic[8];
+        static std::string IndexDir;
+    };
+}
+
+#endif /* _DIRINDEX_H_ */
@@ -0,0 +1,40 @@
+#include <gdkmm.h>
+
+#include "formats.h"
+using namespace AhoViewer;
+
+#include "archive/archive.h"
+#include "config.h"
+
+Formats::Formats()
+{
+    for (const Gdk::PixbufFormat &f : Gdk::Pixbuf::get_formats())
+    {
+        std::vector<Glib::ustring> mimeTypes = f.get_mime_types();
+        Format format { Kind::IMAGE, f.get_name(), mimeTypes.empty() ? "" : mimeTypes.front() };
+
+        for (const std::string &ext : f.get_extensions())
+            m_Formats.emplace(Glib::ustring(ext).lowercase(), format);
+    }
+
+#ifdef HAVE_GSTREAMER
+    m_Formats.emplace("webm", Format { Kind::WEBM, "webm", "video/webm" });
+#endif // HAVE_GSTREAMER
+
+    for (const std::string &ext : Archive::FileExtensions)
+        m_Formats.emplace(ext, Format { Kind::ARCHIVE, ext, "" });
+}
+
+const Formats::Format* Formats::find(const std::string &path) const
+{
+    size_t i = path.find_last_of('.');
+    if (i == std::string::npos)
+        return nullptr;
+
+    std::string ext = path.substr(i + 1);
+    for (char &c : ext)
+        c = g_ascii_tolower(c);
+
+    auto it = m_Formats.find(ext);
+    return it != m_Formats.end() ? &it->second : nullptr;
+}
@@ -0,0 +1,61 @@
+#ifndef _FORMATS_H_
+#define _FORMATS_H_
+
+#include <string>
+#include <unordered_map>
+
+namespace AhoViewer
+{
+    // Every file type that can be opened, keyed by lowercase file extension.
+    // It's built once from the gdk-pixbuf loaders, webm and the archive backends
+    // and never changes afterwards, so it can be used from any thread.
+    class Formats
+    {
+    public:
+        enum class Kind
+        {
+            IMAGE,
+            WEBM,
+            ARCHIVE,
+        };
+
+        struct Format
+        {
+            Kind kind;
+            // The gdk-pixbuf format name for images, otherwise the extension
+            std::string name;
+            std::string mimeType;
+        };
+
+        static const Formats& get_instance()
+        {
+            static const Formats i;
+            return i;
+        }
+
+        // Returns nullptr if the extension of path is not supported
+        const Format* find(const std::string &path) const;
+
+        bool is_image(const std::string &path) const
+        {
+            const Format *f = find(path);
+            return f && f->kind != Kind::ARCHIVE;
+        }
+        bool is_webm(const std::string &path) const
+        {
+            const Format *f = find(path);
+            return f && f->kind == Kind::WEBM;
+        }
+        bool is_archive(const std::string &path) const
+        {
+            const Format *f = find(path);
+            return f && f->kind == Kind::ARCHIVE;
+        }
+    private:
+        Formats();
+
+        std::unordered_map<std::string, Format> m_Formats;
+    };
+}
+
+#endif /* _FORMATS_H_ */
@@ -1,9 +1,11 @@
-#include <cctype>
+#include <chrono>
 #include <iostream>
 
 #include "image.h"
 using namespace AhoViewer;
 
+#include "formats.h"
+#include "scaler.h"
 #include "settings.h"
 
 std::string Image::ThumbnailDir = Glib::build_filename(Glib::get_user_cache_dir(), "thumbnails", "normal");
@@ -15,37 +17,14 @@ bool Image::is_valid(const std::string &path)
 
 bool Image::is_valid_extension(const std::string &path)
 {
-    std::string ext = path.substr(path.find_last_of('.') + 1);
-    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-
-    for (const Gdk::PixbufFormat &i : Gdk::Pixbuf::get_formats())
-        for (const std::string &j : i.get_extensions())
-            if (ext == j)
-                return true;
-
-#ifdef HAVE_GSTREAMER
-    if (ext == "webm")
-        return true;
-#endif // HAVE_GSTREAMER
-
-    return false;
+    return Formats::get_instance().is_image(path);
 }
 
-#ifdef HAVE_GSTREAMER
+// Gio::content_type_guess without any data only looked at the file name,
+// which is what the format registry does without the mime database lookup
 bool Image::is_webm(const std::string &path)
-#else
-bool Image::is_webm(const std::string&)
-#endif // HAVE_GSTREAMER
 {
-#ifdef HAVE_GSTREAMER
-    bool uncertain;
-    std::string ct       = Gio::content_type_guess(path, NULL, 0, uncertain);
-    std::string mimeType = Gio::content_type_get_mime_type(ct);
-
-    return mimeType == "video/webm";
-#else
-    return false;
-#endif // HAVE_GSTREAMER
+    return Formats::get_instance().is_webm(path);
 }
 
 const Glib::RefPtr<Gdk::Pixbuf>& Image::get_missing_pixbuf()
@@ -56,12 +35,70 @@ const Glib::RefPtr<Gdk::Pixbuf>& Image::get_missing_pixbuf()
     return pixbuf;
 }
 
+/**
+ * Returns the number of bytes used by every frame of the animation.
+ * This forces all frames of the animation to be composited.
+ **/
+size_t Image::get_pixbuf_size(const Glib::RefPtr<Gdk::PixbufAnimation> &pixbuf)
+{
+    if (!pixbuf)
+        return 0;
+
+    if (pixbuf->is_static_image())
+    {
+        Glib::RefPtr<Gdk::Pixbuf> p = pixbuf->get_static_image();
+        return p->get_rowstride() * p->get_height();
+    }
+
+    size_t size = 0;
+    GTimeVal time = { 0, 0 };
+    GdkPixbufAnimationIter *iter = gdk_pixbuf_animation_get_iter(pixbuf->gobj(), &time);
+    GdkPixbuf *first = gdk_pixbuf_animation_iter_get_pixbuf(iter);
+
+    for (size_t i = 0; i < MaxAnimationFrames; ++i)
+    {
+        GdkPixbuf *p = gdk_pixbuf_animation_iter_get_pixbuf(iter);
+        int delay = gdk_pixbuf_animation_iter_get_delay_time(iter);
+
+        // Looped back to the first frame
+        if (i > 0 && p == first)
+            break;
+
+        size += gdk_pixbuf_get_rowstride(p) * gdk_pixbuf_get_height(p);
+
+        if (delay < 0)
+            break;
+
+        g_time_val_add(&time, std::max(delay, 1) * 1000);
+        gdk_pixbuf_animation_iter_advance(iter, &time);
+    }
+
+    g_object_unref(iter);
+
+    return size;
+}
+
 Image::Image(const std::string &path)
   : m_Loading(false),
-    m_isWebM(Image::is_webm(path)),
-    m_Path(path)
+    m_PixbufSize(0),
+    m_Reduced(false),
+    m_FullWidth(0),
+    m_FullHeight(0),
+    m_ThumbnailOnDisk(false),
+    m_Path(path),
+    m_SignalPixbufChanged(nullptr),
+    m_WebM(-1)
+{
+
+}
+
+bool Image::is_webm() const
 {
+    // Every thread that races here gets the same answer
+    if (m_WebM < 0)
+        m_WebM = is_webm(m_Path);
 
+    return m_WebM;
 }
 
 std::string Image::get_filename() const
@@ -71,15 +108,155 @@ std::string Image::get_filename() const
             Glib::path_get_basename(m_Path));
 }
 
+void Image::set_pixbuf_changed_dispatcher(Glib::Dispatcher *dispatcher)
+{
+    Glib::Threads::Mutex::Lock lock(m_SignalMutex);
+    m_SignalPixbufChanged = dispatcher;
+}
+
+void Image::emit_pixbuf_changed()
+{
+    Glib::Threads::Mutex::Lock lock(m_SignalMutex);
+
+    if (m_SignalPixbufChanged)
+        m_SignalPixbufChanged->emit();
+}
+
 const Glib::RefPtr<Gdk::PixbufAnimation>& Image::get_pixbuf()
 {
     Glib::Threads::Mutex::Lock lock(m_Mutex);
     return m_Pixbuf;
 }
 
+size_t Image::get_pixbuf_size()
+{
+    Glib::Threads::Mutex::Lock lock(m_Mutex);
+
+    if (m_PixbufSize == 0 && m_Pixbuf && !m_Loading)
+        m_PixbufSize = get_pixbuf_size(m_Pixbuf);
+
+    size_t size = m_PixbufSize;
+
+    if (m_ScaledPixbuf)
+        size += m_ScaledPixbuf->get_rowstride() * m_ScaledPixbuf->get_height();
+
+    for (const Glib::RefPtr<Gdk::Pixbuf> &p : m_Mipmaps)
+        size += p->get_rowstride() * p->get_height();
+
+    return size;
+}
+
+void Image::get_full_size(int &w, int &h)
+{
+    Glib::Threads::Mutex::Lock lock(m_Mutex);
+
+    if (m_Reduced)
+    {
+        w = m_FullWidth;
+        h = m_FullHeight;
+    }
+    else if (m_Pixbuf)
+    {
+        w = m_Pixbuf->get_width();
+        h = m_Pixbuf->get_height();
+    }
+    else
+    {
+        w = h = 0;
+    }
+}
+
+Glib::RefPtr<Gdk::Pixbuf> Image::get_scaled_pixbuf(const int w, const int h)
+{
+    Glib::Threads::Mutex::Lock lock(m_Mutex);
+
+    if (m_ScaledPixbuf && m_ScaledPixbuf->get_width() == w && m_ScaledPixbuf->get_height() == h)
+        return m_ScaledPixbuf;
+
+    return Glib::RefPtr<Gdk::Pixbuf>();
+}
+
+void Image::set_scaled_pixbuf(const Glib::RefPtr<Gdk::Pixbuf> &pixbuf)
+{
+    Glib::Threads::Mutex::Lock lock(m_Mutex);
+
+    if (m_Pixbuf)
+        m_ScaledPixbuf = pixbuf;
+}
+
+void Image::create_scaled_pixbuf(const int w, const int h)
+{
+    Glib::RefPtr<Gdk::PixbufAnimation> pixbuf;
+    {
+        Glib::Threads::Mutex::Lock lock(m_Mutex);
+
+        if (!m_Pixbuf || m_Loading || !m_Pixbuf->is_static_image() ||
+            (m_ScaledPixbuf && m_ScaledPixbuf->get_width() == w && m_ScaledPixbuf->get_height() == h))
+            return;
+
+        pixbuf = m_Pixbuf;
+    }
+
+    Glib::RefPtr<Gdk::Pixbuf> scaled;
+    if (pixbuf->get_width() != w || pixbuf->get_height() != h)
+        scaled = Scaler::scale(get_mipmap(w, h), w, h);
+
+    Glib::Threads::Mutex::Lock lock(m_Mutex);
+
+    // The pixbuf could have been reset while it was being scaled
+    if (m_Pixbuf == pixbuf)
+        m_ScaledPixbuf = scaled;
+}
+
+Glib::RefPtr<Gdk::Pixbuf> Image::get_mipmap(const int w, const int h)
+{
+    Glib::Threads::Mutex::Lock lock(m_Mutex);
+
+    if (!m_Pixbuf || !m_Pixbuf->is_static_image())
+        return Glib::RefPtr<Gdk::Pixbuf>();
+
+    for (std::vector<Glib::RefPtr<Gdk::Pixbuf>>::reverse_iterator i = m_Mipmaps.rbegin();
+         i != m_Mipmaps.rend(); ++i)
+    {
+        if ((*i)->get_width() >= w && (*i)->get_height() >= h)
+            return *i;
+    }
+
+    return m_Pixbuf->get_static_image();
+}
+
+void Image::create_mipmaps()
+{
+    Glib::RefPtr<Gdk::PixbufAnimation> pixbuf;
+    {
+        Glib::Threads::Mutex::Lock lock(m_Mutex);
+
+        if (!m_Pixbuf || m_Loading || !m_Pixbuf->is_static_image() || !m_Mipmaps.empty())
+            return;
+
+        pixbuf = m_Pixbuf;
+    }
+
+    std::vector<Glib::RefPtr<Gdk::Pixbuf>> mipmaps;
+    Glib::RefPtr<Gdk::Pixbuf> level = pixbuf->get_static_image();
+
+    // Each level is made from the previous one, the smallest is still big enough for a thumbnail
+    while (std::max(level->get_width(), level->get_height()) / 2 >= 128 &&
+           std::min(level->get_width(), level->get_height()) / 2 >= 1)
+    {
+        level = Scaler::scale(level, level->get_width() / 2, level->get_height() / 2, Scaler::Filter::BOX);
+        mipmaps.push_back(level);
+    }
+
+    Glib::Threads::Mutex::Lock lock(m_Mutex);
+
+    if (m_Pixbuf == pixbuf)
+        m_Mipmaps.swap(mipmaps);
+}
+
 const Glib::RefPtr<Gdk::Pixbuf>& Image::get_thumbnail()
 {
-    if (m_ThumbnailPixbuf)
+    if (m_ThumbnailPixbuf || restore_thumbnail())
         return m_ThumbnailPixbuf;
 
 #ifdef __linux__
@@ -111,7 +288,10 @@ const Glib::RefPtr<Gdk::Pixbuf>& Image::get_thumbnail()
                 time_t mtime = strtol(s.c_str(), nullptr, 10);
 
                 if ((stat(m_Path.c_str(), &fileInfo) == 0) && fileInfo.st_mtime == mtime)
+                {
                     m_ThumbnailPixbuf = pixbuf;
+                    m_ThumbnailOnDisk = true;
+                }
             }
         }
     }
@@ -123,28 +303,230 @@ const Glib::RefPtr<Gdk::Pixbuf>& Image::get_thumbnail()
     return m_ThumbnailPixbuf;
 }
 
-void Image::load_pixbuf()
+void Image::load_pixbuf(const SizeFunc &decodeSize, const Glib::RefPtr<Gio::Cancellable> &cancellable)
+{
+    if (!is_webm() && decode_file(decodeSize, cancellable))
+        emit_pixbuf_changed();
+}
+
+void Image::reset_pixbuf()
+{
+    Glib::Threads::Mutex::Lock lock(m_Mutex);
+    m_Pixbuf.reset();
+    m_ScaledPixbuf.reset();
+    m_Mipmaps.clear();
+    m_PixbufSize = 0;
+    m_Reduced = false;
+}
+
+bool Image::decode_file(const SizeFunc &decodeSize, const Glib::RefPtr<Gio::Cancellable> &cancellable)
 {
-    if (!m_Pixbuf && !m_isWebM)
+    bool partial, wasLoading;
     {
-        Glib::RefPtr<Gdk::PixbufAnimation> p = Gdk::PixbufAnimation::create_from_file(m_Path);
+        Glib::Threads::Mutex::Lock lock(m_Mutex);
+
+        if (m_Pixbuf)
+        {
+            int w, h;
+
+            // Already decoded at full size, or at a size that is still large enough
+            if (!m_Reduced || (decodeSize && decodeSize(m_FullWidth, m_FullHeight, w, h) &&
+                               w <= m_Pixbuf->get_width() && h <= m_Pixbuf->get_height()))
+                return false;
+        }
+
+        // Only the first decode is shown while it's loading,
+        // an image that is decoded again keeps showing the smaller pixbuf
+        partial = !m_Pixbuf;
+        wasLoading = m_Loading;
+    }
+
+    Glib::RefPtr<Gdk::PixbufLoader> loader = Gdk::PixbufLoader::create();
+    int fullWidth = 0, fullHeight = 0;
+    bool reduced = false, published = false;
+    std::chrono::steady_clock::time_point lastUpdate;
+
+    loader->signal_size_prepared().connect([ &loader, &decodeSize, &fullWidth, &fullHeight, &reduced ](int w, int h)
+    {
+        int dw, dh;
+        fullWidth  = w;
+        fullHeight = h;
+
+        // The JPEG loader uses this to decode at a fraction of the size (DCT scaling),
+        // other loaders scale the image as it is decoded
+        if (decodeSize && can_decode_reduced(loader) &&
+            decodeSize(w, h, dw, dh) && dw < w && dh < h)
+        {
+            loader->set_size(dw, dh);
+            reduced = true;
+        }
+    });
+
+    if (partial)
+    {
+        // Progressive JPEGs and interlaced PNGs are drawn as they are decoded.
+        // Animations aren't, frames are added to the animation while it's being
+        // decoded and iterating it from the main thread would race with that.
+        loader->signal_area_prepared().connect([ & ]()
+        {
+            if (can_animate(loader))
+                return;
+
+            {
+                Glib::Threads::Mutex::Lock lock(m_Mutex);
+                m_Pixbuf     = loader->get_animation();
+                m_Loading    = true;
+                m_Reduced    = reduced;
+                m_FullWidth  = fullWidth;
+                m_FullHeight = fullHeight;
+            }
+            published = true;
+            lastUpdate = std::chrono::steady_clock::now();
+            emit_pixbuf_changed();
+        });
+        loader->signal_area_updated().connect([ & ](int, int, int, int)
+        {
+            using namespace std::chrono;
+            if (published && steady_clock::now() >= lastUpdate + milliseconds(100))
+            {
+                emit_pixbuf_changed();
+                lastUpdate = steady_clock::now();
+            }
+        });
+    }
+
+    // Takes back the partially decoded pixbuf
+    auto unpublish = [ & ]()
+    {
+        try { loader->close(); }
+        catch (...) { }
+
+        if (published)
         {
             Glib::Threads::Mutex::Lock lock(m_Mutex);
-            m_Pixbuf = p;
+            m_Pixbuf.reset();
+            m_Loading = wasLoading;
+            m_Reduced = false;
+        }
+    };
+
+    try
+    {
+        Glib::RefPtr<Gio::FileInputStream> stream = Gio::File::create_for_path(m_Path)->read();
+        std::vector<guint8> buf(DecodeChunkSize);
+        gssize n;
+
+        // The cancellable is checked between chunks so the prefetcher
+        // doesn't have to wait for large images to finish decoding
+        while ((n = stream->read(buf.data(), buf.size())) > 0)
+        {
+            if (cancellable && cancellable->is_cancelled())
+            {
+                unpublish();
+                return published;
+            }
+
+            loader->write(buf.data(), n);
         }
-        m_SignalPixbufChanged();
+
+        loader->close();
     }
+    catch (...)
+    {
+        unpublish();
+        throw;
+    }
+
+    Glib::RefPtr<Gdk::PixbufAnimation> p = loader->get_animation();
+    if (!p)
+        throw Gdk::PixbufError(Gdk::PixbufError::CORRUPT_IMAGE, "Failed to load " + get_filename());
+
+    size_t size = get_pixbuf_size(p);
+
+    Glib::Threads::Mutex::Lock lock(m_Mutex);
+    m_Pixbuf       = p;
+    m_PixbufSize   = size;
+    m_Reduced      = reduced;
+    m_FullWidth    = fullWidth;
+    m_FullHeight   = fullHeight;
+    // These were made from the previous pixbuf
+    m_ScaledPixbuf.reset();
+    m_Mipmaps.clear();
+
+    if (published)
+        m_Loading = false;
+
+    return true;
 }
 
-void Image::reset_pixbuf()
+bool Image::can_decode_reduced(const Glib::RefPtr<Gdk::PixbufLoader> &loader)
 {
-    Glib::Threads::Mutex::Lock lock(m_Mutex);
-    m_Pixbuf.reset();
+    // Formats that can be animated are always decoded at full size
+    return !can_animate(loader);
+}
+
+bool Image::can_animate(const Glib::RefPtr<Gdk::PixbufLoader> &loader)
+{
+    std::string name = loader->get_format().get_name();
+    return name == "gif" || name == "ani" || name == "webp";
+}
+
+bool Image::unload_thumbnail()
+{
+    if (!m_ThumbnailPixbuf || m_ThumbnailPixbuf == get_missing_pixbuf())
+        return !m_ThumbnailData.empty();
+
+    // A PNG of a thumbnail is a fraction of its decoded size
+    if (!m_ThumbnailOnDisk)
+    {
+        gchar *buf;
+        gsize bufSize;
+
+        try
+        {
+            m_ThumbnailPixbuf->save_to_buffer(buf, bufSize, "png");
+            m_ThumbnailData.assign(buf, buf + bufSize);
+            g_free(buf);
+        }
+        catch (const Glib::Error &ex)
+        {
+            // It will be created again instead
+            std::cerr << "Error while compressing thumbnail for " << get_filename()
+                      << ": " << std::endl << "  " << ex.what() << std::endl;
+        }
+    }
+
+    m_ThumbnailPixbuf.reset();
+
+    return !m_ThumbnailData.empty();
+}
+
+bool Image::restore_thumbnail()
+{
+    if (m_ThumbnailData.empty())
+        return false;
+
+    try
+    {
+        Glib::RefPtr<Gdk::PixbufLoader> loader = Gdk::PixbufLoader::create("png");
+        loader->write(reinterpret_cast<const guint8*>(m_ThumbnailData.data()), m_ThumbnailData.size());
+        loader->close();
+        m_ThumbnailPixbuf = loader->get_pixbuf();
+    }
+    catch (const Glib::Error &ex)
+    {
+        std::cerr << "Error while restoring thumbnail for " << get_filename()
+                  << ": " << std::endl << "  " << ex.what() << std::endl;
+    }
+
+    std::vector<gchar>().swap(m_ThumbnailData);
+
+    return !!m_ThumbnailPixbuf;
 }
 
 void Image::create_thumbnail()
 {
-    if (m_isWebM)
+    if (is_webm())
     {
         m_ThumbnailPixbuf = create_webm_thumbnail(ThumbnailSize, ThumbnailSize);
     }
@@ -152,7 +534,10 @@ void Image::create_thumbnail()
     {
         try
         {
-            m_ThumbnailPixbuf = create_pixbuf_at_size(m_Path, ThumbnailSize, ThumbnailSize);
+            m_ThumbnailPixbuf = create_thumbnail_from_mipmaps(ThumbnailSize, ThumbnailSize);
+
+            if (!m_ThumbnailPixbuf)
+                m_ThumbnailPixbuf = create_pixbuf_at_size(m_Path, ThumbnailSize, ThumbnailSize);
         }
         catch (const Gdk::PixbufError &ex)
         {
@@ -164,22 +549,118 @@ void Image::create_thumbnail()
 }
 
 // FIXME: https://bugzilla.gnome.org/show_bug.cgi?id=735422 workaround
+// Loaders that scale while decoding do it with a poor filter, so they are only
+// asked for sizes they can decode at directly and Scaler does the rest.
 Glib::RefPtr<Gdk::Pixbuf> Image::create_pixbuf_at_size(const std::string &path,
                                                        const int w, const int h) const
 {
-    Glib::RefPtr<Gdk::Pixbuf> pixbuf = Gdk::Pixbuf::create_from_file(path);
+    Glib::RefPtr<Gdk::PixbufLoader> loader = Gdk::PixbufLoader::create();
+
+    loader->signal_size_prepared().connect([ &loader, w, h ](int fullWidth, int fullHeight)
+    {
+        int dw, dh;
+        if (get_thumbnail_decode_size(loader->get_format().get_name(),
+                                      fullWidth, fullHeight, w, h, dw, dh))
+            loader->set_size(dw, dh);
+    });
+
+    try
+    {
+        Glib::RefPtr<Gio::FileInputStream> stream = Gio::File::create_for_path(path)->read();
+        std::vector<guint8> buf(DecodeChunkSize);
+        gssize n;
+
+        while ((n = stream->read(buf.data(), buf.size())) > 0)
+            loader->write(buf.data(), n);
+
+        loader->close();
+    }
+    catch (const Glib::Error &ex)
+    {
+        try { loader->close(); }
+        catch (...) { }
+
+        if (dynamic_cast<const Gdk::PixbufError*>(&ex))
+            throw;
+
+        // Callers only expect pixbuf errors, like Gdk::Pixbuf::create_from_file
+        throw Gdk::PixbufError(Gdk::PixbufError::FAILED, ex.what());
+    }
+
+    Glib::RefPtr<Gdk::Pixbuf> pixbuf = loader->get_pixbuf();
+    if (!pixbuf)
+        throw Gdk::PixbufError(Gdk::PixbufError::CORRUPT_IMAGE, "Failed to load " + path);
+
     return scale_pixbuf(pixbuf, w, h);
 }
 
+bool Image::get_thumbnail_decode_size(const std::string &format,
+                                      const int fullWidth, const int fullHeight,
+                                      const int w, const int h, int &dw, int &dh)
+{
+    double r = std::min(static_cast<double>(w) / fullWidth,
+                        static_cast<double>(h) / fullHeight);
+
+    if (r >= 1.0)
+        return false;
+
+    // Vector images are rendered at the requested size
+    if (format == "svg")
+    {
+        dw = std::max(static_cast<int>(fullWidth * r), 1);
+        dh = std::max(static_cast<int>(fullHeight * r), 1);
+        return true;
+    }
+
+    // libjpeg decodes at 1/2, 1/4 or 1/8 of the size (DCT scaling).
+    // Asking for exactly that size means the loader doesn't scale it any further
+    if (format == "jpeg")
+    {
+        int denom = 8;
+        while (denom > 1 && denom * r > 1.0)
+            denom /= 2;
+
+        if (denom == 1)
+            return false;
+
+        dw = (fullWidth + denom - 1) / denom;
+        dh = (fullHeight + denom - 1) / denom;
+        return true;
+    }
+
+    // Everything else is decoded at full size, PNG and the rest have no reduced decode
+    return false;
+}
+
 Glib::RefPtr<Gdk::Pixbuf> Image::scale_pixbuf(Glib::RefPtr<Gdk::Pixbuf> &pixbuf,
                                               const int w, const int h) const
 {
     double r = std::min(static_cast<double>(w) / pixbuf->get_width(),
                         static_cast<double>(h) / pixbuf->get_height());
 
-    return pixbuf->scale_simple(std::max(pixbuf->get_width() * r, 20.0),
-                                std::max(pixbuf->get_height() * r, 20.0),
-                                Gdk::INTERP_BILINEAR);
+    return Scaler::scale(pixbuf, std::max(pixbuf->get_width() * r, 20.0),
+                                 std::max(pixbuf->get_height() * r, 20.0));
+}
+
+Glib::RefPtr<Gdk::Pixbuf> Image::create_thumbnail_from_mipmaps(const int w, const int h)
+{
+    double r;
+    int width, height;
+    {
+        Glib::Threads::Mutex::Lock lock(m_Mutex);
+
+        if (m_Mipmaps.empty())
+            return Glib::RefPtr<Gdk::Pixbuf>();
+
+        width  = m_Pixbuf->get_width();
+        height = m_Pixbuf->get_height();
+    }
+
+    // The size of the thumbnail scale_pixbuf will create
+    r = std::min(static_cast<double>(w) / width, static_cast<double>(h) / height);
+    Glib::RefPtr<Gdk::Pixbuf> pixbuf = get_mipmap(width * r, height * r);
+
+    return pixbuf ? scale_pixbuf(pixbuf, w, h) : pixbuf;
 }
 
 Glib::RefPtr<Gdk::Pixbuf> Image::create_webm_thumbnail(const int w, const int h) const
@@ -323,7 +804,7 @@ void Image::create_save_thumbnail()
     int w, h;
     Glib::RefPtr<Gdk::Pixbuf> pixbuf;
 
-    if (m_isWebM)
+    if (is_webm())
     {
         pixbuf = create_webm_thumbnail(128, 128, w, h);
 
@@ -337,7 +818,10 @@ void Image::create_save_thumbnail()
         {
             try
             {
-                pixbuf = create_pixbuf_at_size(m_Path, 128, 128);
+                pixbuf = create_thumbnail_from_mipmaps(128, 128);
+
+                if (!pixbuf)
+                    pixbuf = create_pixbuf_at_size(m_Path, 128, 128);
             }
             catch (const Gdk::PixbufError &ex)
             {
@@ -362,7 +846,7 @@ void Image::create_save_thumbnail()
 }
 
 void Image::save_thumbnail(Glib::RefPtr<Gdk::Pixbuf> &pixbuf,
-                           const int w, const int h, const gchar *mimeType) const
+                           const int w, const int h, const gchar *mimeType)
 {
     if (!Settings.get_bool("SaveThumbnails"))
         return;
@@ -404,6 +888,7 @@ void Image::save_thumbnail(Glib::RefPtr<Gdk::Pixbuf> &pixbuf,
             {
                 Glib::file_set_contents(m_ThumbnailPath, buf, bufSize);
                 chmod(m_ThumbnailPath.c_str(), S_IRUSR | S_IWUSR);
+                m_ThumbnailOnDisk = true;
             }
             catch (const Glib::FileError &ex)
             {
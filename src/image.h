@@ -1,8 +1,12 @@
 #ifndef _IMAGE_H_
 #define _IMAGE_H_
 
+#include <atomic>
+#include <functional>
 #include <gdkmm.h>
+#include <giomm.h>
 #include <glibmm.h>
+#include <vector>
 
 #include "config.h"
 
@@ -15,45 +19,98 @@ namespace AhoViewer
     class Image
     {
     public:
+        // Given the original size of an image sets w and h to the size it will be displayed at,
+        // returns false if the size is not known.
+        using SizeFunc = std::function<bool(const int, const int, int&, int&)>;
+
         Image(const std::string &path);
         virtual ~Image() = default;
 
         static bool is_valid(const std::string &path);
         static bool is_valid_extension(const std::string &path);
         static const Glib::RefPtr<Gdk::Pixbuf>& get_missing_pixbuf();
+        static size_t get_pixbuf_size(const Glib::RefPtr<Gdk::PixbufAnimation> &pixbuf);
 
         const std::string get_path() const { return m_Path; }
         bool is_loading() const { return m_Loading; }
-        bool is_webm() const { return m_isWebM; }
+        // Classified by the first call instead of when the image is created,
+        // most images of a large directory are never decoded
+        bool is_webm() const;
 
         virtual std::string get_filename() const;
         virtual const Glib::RefPtr<Gdk::PixbufAnimation>& get_pixbuf();
+        // The amount of memory used by the decoded frames of m_Pixbuf
+        size_t get_pixbuf_size();
+        // The size of the image file, m_Pixbuf is smaller if it was decoded at a reduced size
+        void get_full_size(int &w, int &h);
+
+        // Returns the display sized copy of the pixbuf if it is w x h, otherwise nullptr.
+        Glib::RefPtr<Gdk::Pixbuf> get_scaled_pixbuf(const int w, const int h);
+        void set_scaled_pixbuf(const Glib::RefPtr<Gdk::Pixbuf> &pixbuf);
+        // Creates the display sized copy of a static image, this is called from the prefetcher.
+        void create_scaled_pixbuf(const int w, const int h);
+        // Returns the smallest mipmap level that is at least w x h,
+        // the full size image if there is none.
+        Glib::RefPtr<Gdk::Pixbuf> get_mipmap(const int w, const int h);
+        // Creates the halved copies of a static image down to the thumbnail size,
+        // this is called from the prefetcher.
+        void create_mipmaps();
         virtual const Glib::RefPtr<Gdk::Pixbuf>& get_thumbnail();
-
-        virtual void load_pixbuf();
+        // Frees the thumbnail, get_thumbnail loads it again from the thumbnail cache on disk
+        // or from a PNG compressed copy that is kept in memory.
+        // Returns true if a copy was kept, it's lost when the image is freed.
+        virtual bool unload_thumbnail();
+
+        // When decodeSize returns a size smaller than the image, the image is decoded at that size.
+        // An image decoded at a reduced size is decoded again once it is needed at a larger size.
+        // Decoding stops early when cancellable is cancelled, cancellable can be empty.
+        virtual void load_pixbuf(const SizeFunc &decodeSize, const Glib::RefPtr<Gio::Cancellable> &cancellable);
         virtual void reset_pixbuf();
 
-        Glib::Dispatcher& signal_pixbuf_changed() { return m_SignalPixbufChanged; }
+        // Set on the main thread by the ImageBox showing the image and cleared before
+        // it's replaced. The dispatcher isn't owned by the image, images are also
+        // created and freed by worker threads and most are never shown.
+        void set_pixbuf_changed_dispatcher(Glib::Dispatcher *dispatcher);
 
         static const size_t ThumbnailSize = 100;
     protected:
         static bool is_webm(const std::string&);
 
         void create_thumbnail();
+        // Decodes the copy made by unload_thumbnail, returns false if there is none.
+        bool restore_thumbnail();
+        // Decodes m_Path if it's not decoded yet or m_Pixbuf is too small,
+        // returns true if m_Pixbuf was replaced. The first decode of an image
+        // is published as soon as the loader has allocated the pixbuf.
+        bool decode_file(const SizeFunc &decodeSize, const Glib::RefPtr<Gio::Cancellable> &cancellable);
+        // Emits m_SignalPixbufChanged if the image is shown, can be called from any thread
+        void emit_pixbuf_changed();
         Glib::RefPtr<Gdk::Pixbuf> create_pixbuf_at_size(const std::string &path,
                                                         const int w, const int h) const;
 
-        bool m_Loading, m_isWebM;
+        bool m_Loading;
+        size_t m_PixbufSize;
+        bool m_Reduced;
+        int m_FullWidth, m_FullHeight;
+        // m_ThumbnailPath holds an up to date thumbnail
+        bool m_ThumbnailOnDisk;
         std::string m_Path, m_ThumbnailPath;
+        std::vector<gchar> m_ThumbnailData;
 
-        Glib::RefPtr<Gdk::Pixbuf> m_ThumbnailPixbuf;
+        Glib::RefPtr<Gdk::Pixbuf> m_ThumbnailPixbuf, m_ScaledPixbuf;
         Glib::RefPtr<Gdk::PixbufAnimation> m_Pixbuf;
+        // Largest first, each level is half the size of the previous one
+        std::vector<Glib::RefPtr<Gdk::Pixbuf>> m_Mipmaps;
 
         Glib::Threads::Mutex m_Mutex;
-        Glib::Dispatcher m_SignalPixbufChanged;
+        // Held while emitting so the dispatcher can't be cleared and destroyed in between
+        Glib::Threads::Mutex m_SignalMutex;
+        Glib::Dispatcher *m_SignalPixbufChanged;
     private:
         Glib::RefPtr<Gdk::Pixbuf> scale_pixbuf(Glib::RefPtr<Gdk::Pixbuf> &pixbuf,
                                                const int w, const int h) const;
+        // Returns nullptr if the image has no mipmaps
+        Glib::RefPtr<Gdk::Pixbuf> create_thumbnail_from_mipmaps(const int w, const int h);
         Glib::RefPtr<Gdk::Pixbuf> create_webm_thumbnail(const int w, const int h) const;
         Glib::RefPtr<Gdk::Pixbuf> create_webm_thumbnail(const int w, const int h,
                                                         int &oWidth, int &oHeight) const;
@@ -64,10 +121,26 @@ namespace AhoViewer
 
         static constexpr double BoringImageVariance = 256.0;
 #endif // HAVE_GSTREAMER
+        // Upper limit of frames counted by get_pixbuf_size
+        static const size_t MaxAnimationFrames = 1000;
+        // Bytes read from the file per PixbufLoader::write
+        static const size_t DecodeChunkSize = 64 * 1024;
+
+        static bool can_decode_reduced(const Glib::RefPtr<Gdk::PixbufLoader> &loader);
+        static bool can_animate(const Glib::RefPtr<Gdk::PixbufLoader> &loader);
+        // Sets dw and dh to the size a loader of format can decode a fullWidth x fullHeight
+        // image at without scaling it itself, returns false if it has to be decoded at full size.
+        static bool get_thumbnail_decode_size(const std::string &format,
+                                              const int fullWidth, const int fullHeight,
+                                              const int w, const int h, int &dw, int &dh);
+
         void create_save_thumbnail();
         void save_thumbnail(Glib::RefPtr<Gdk::Pixbuf> &pixbuf,
-                            const int w, const int h, const gchar *mimeType) const;
+                            const int w, const int h, const gchar *mimeType);
         static std::string ThumbnailDir;
+
+        // -1 until is_webm is called, can be set from any thread
+        mutable std::atomic<int> m_WebM;
     };
 }
 
@@ -2,6 +2,7 @@
 using namespace AhoViewer;
 
 #include "mainwindow.h"
+#include "scaler.h"
 #include "settings.h"
 #include "statusbar.h"
 
@@ -52,7 +53,9 @@ ImageBox::ImageBox(BaseObjectType *cobj, const Glib::RefPtr<Gtk::Builder> &bldr)
     m_RedrawQueued(false),
     m_ZoomScroll(false),
     m_ZoomMode(Settings.get_zoom_mode()),
-    m_ZoomPercent(100)
+    m_ZoomPercent(100),
+    m_Tiled(false),
+    m_HasScaleParams(false)
 {
     bldr->get_widget("ImageBox::Layout",       m_Layout);
     bldr->get_widget("ImageBox::HScroll",      m_HScroll);
@@ -66,6 +69,12 @@ ImageBox::ImageBox(BaseObjectType *cobj, const Glib::RefPtr<Gtk::Builder> &bldr)
     m_VAdjust = Glib::RefPtr<Gtk::Adjustment>::cast_static(bldr->get_object("ImageBox::VAdjust"));
     m_UIManager = Glib::RefPtr<Gtk::UIManager>::cast_static(bldr->get_object("UIManager"));
 
+    // Draw the tiles before the layout's children
+    m_Layout->signal_expose_event().connect(sigc::mem_fun(*this, &ImageBox::on_layout_expose_event), false);
+
+    // Emitted by whichever image is shown, an image that was just replaced may still emit it once
+    m_SignalPixbufChanged.connect(sigc::bind(sigc::mem_fun(*this, &ImageBox::queue_draw_image), false));
+
 #ifdef HAVE_GSTREAMER
     m_Playbin   = gst_element_factory_make("playbin", "playbin"),
     m_VideoSink = gst_element_factory_make("glimagesink", "videosink");
@@ -93,6 +102,45 @@ ImageBox::ImageBox(BaseObjectType *cobj, const Glib::RefPtr<Gtk::Builder> &bldr)
 #endif // HAVE_GSTREAMER
 }
 
+ImageBox::~ImageBox()
+{
+    // Worker threads can still be decoding the image
+    if (m_Image)
+        m_Image->set_pixbuf_changed_dispatcher(nullptr);
+}
+
+bool ImageBox::get_scaled_size(const int origWidth, const int origHeight, int &w, int &h) const
+{
+    ScaleParams params;
+    {
+        Glib::Threads::Mutex::Lock lock(m_ScaleMutex);
+        if (!m_HasScaleParams)
+            return false;
+
+        params = m_ScaleParams;
+    }
+
+    get_scaled_size(params, origWidth, origHeight, w, h);
+
+    return !use_tiles(params, origWidth, origHeight, w, h);
+}
+
+bool ImageBox::get_decode_size(const int origWidth, const int origHeight, int &w, int &h) const
+{
+    ScaleParams params;
+    {
+        Glib::Threads::Mutex::Lock lock(m_ScaleMutex);
+        if (!m_HasScaleParams || m_ScaleParams.zoomMode == ZoomMode::MANUAL)
+            return false;
+
+        params = m_ScaleParams;
+    }
+
+    get_scaled_size(params, origWidth, origHeight, w, h);
+
+    return w < origWidth && h < origHeight;
+}
+
 void ImageBox::queue_draw_image(const bool scroll)
 {
     if (!get_realized() || !m_Image || (m_RedrawQueued && !(scroll || m_Loading)))
@@ -107,7 +155,9 @@ void ImageBox::queue_draw_image(const bool scroll)
 
 void ImageBox::set_image(const std::shared_ptr<Image> &image)
 {
-    m_ImageConn.disconnect();
+    if (m_Image)
+        m_Image->set_pixbuf_changed_dispatcher(nullptr);
+
     reset_slideshow();
 
 #ifdef HAVE_GSTREAMER
@@ -118,15 +168,18 @@ void ImageBox::set_image(const std::shared_ptr<Image> &image)
 
     m_Image = image;
     m_FirstDraw = m_Loading = true;
+    clear_tiles();
     queue_draw_image(true);
-    m_ImageConn = m_Image->signal_pixbuf_changed().connect(
-            sigc::bind(sigc::mem_fun(*this, &ImageBox::queue_draw_image), false));
+    m_Image->set_pixbuf_changed_dispatcher(&m_SignalPixbufChanged);
 }
 
 void ImageBox::clear_image()
 {
     m_SlideshowConn.disconnect();
-    m_ImageConn.disconnect();
+
+    if (m_Image)
+        m_Image->set_pixbuf_changed_dispatcher(nullptr);
+
     m_DrawConn.disconnect();
     m_AnimConn.disconnect();
     m_GtkImage->clear();
@@ -144,6 +197,7 @@ void ImageBox::clear_image()
     m_StatusBar->clear_resolution();
     m_Image = nullptr;
     m_PixbufAnim.reset();
+    clear_tiles();
 }
 
 void ImageBox::update_background_color()
@@ -383,9 +437,6 @@ void ImageBox::draw_image(bool scroll)
 
     Glib::RefPtr<Gdk::Pixbuf> origPixbuf, tempPixbuf;
 
-    bool hideScrollbars = !Settings.get_bool("ScrollbarsVisible") ||
-                           Settings.get_bool("HideAll") || m_ZoomMode == ZoomMode::AUTO_FIT;
-
     // if the image is still loading we want to draw all requests
     m_Loading = m_Image->is_loading();
 
@@ -440,11 +491,16 @@ void ImageBox::draw_image(bool scroll)
                         m_PixbufAnimIter->get_delay_time());
         }
 
-        origPixbuf = m_PixbufAnimIter->get_pixbuf()->copy();
-        tempPixbuf = origPixbuf;
+        origPixbuf = m_PixbufAnimIter->get_pixbuf();
+
+        // The pixbuf is smaller than the image if it was decoded at a reduced size
+        m_Image->get_full_size(m_OrigWidth, m_OrigHeight);
 
-        m_OrigWidth  = origPixbuf->get_width();
-        m_OrigHeight = origPixbuf->get_height();
+        if (m_OrigWidth == 0 || m_OrigHeight == 0)
+        {
+            m_OrigWidth  = origPixbuf->get_width();
+            m_OrigHeight = origPixbuf->get_height();
+        }
 #ifdef HAVE_GSTREAMER
     }
 #endif // HAVE_GSTREAMER
@@ -452,40 +508,69 @@ void ImageBox::draw_image(bool scroll)
     m_HScroll->hide();
     m_VScroll->hide();
 
-    int windowWidth, windowHeight;
-    m_MainWindow->get_drawable_area_size(windowWidth, windowHeight);
-
-    int layoutWidth  = windowWidth - m_VScroll->size_request().width,
-        layoutHeight = windowHeight - m_HScroll->size_request().height;
+    ScaleParams params = get_scale_params();
+    bool scaleChanged;
+    {
+        Glib::Threads::Mutex::Lock lock(m_ScaleMutex);
+        scaleChanged = !m_HasScaleParams || params != m_ScaleParams;
+        m_ScaleParams = params;
+        m_HasScaleParams = true;
+    }
 
-    int w            = windowWidth,
-        h            = windowHeight,
-        scaledWidth  = m_OrigWidth,
-        scaledHeight = m_OrigHeight;
+    bool hideScrollbars = params.hideScrollbars;
+    int windowWidth     = params.windowWidth,
+        windowHeight    = params.windowHeight,
+        layoutWidth     = params.layoutWidth,
+        layoutHeight    = params.layoutHeight,
+        w               = windowWidth,
+        h               = windowHeight,
+        scaledWidth, scaledHeight;
 
-    double windowAspect = static_cast<double>(windowWidth) / windowHeight,
-           imageAspect  = static_cast<double>(m_OrigWidth) / m_OrigHeight;
+    get_scaled_size(params, m_OrigWidth, m_OrigHeight, scaledWidth, scaledHeight);
 
-    if ((m_OrigWidth > windowWidth || (m_OrigHeight > windowHeight && m_OrigWidth > layoutWidth)) &&
-        (m_ZoomMode == ZoomMode::FIT_WIDTH || (m_ZoomMode == ZoomMode::AUTO_FIT && windowAspect <= imageAspect)))
+    if (!m_Image->is_webm())
     {
-        scaledWidth = std::ceil(windowWidth / imageAspect) > windowHeight && !hideScrollbars ? layoutWidth : windowWidth;
-        scaledHeight = std::ceil(scaledWidth / imageAspect);
-    }
-    else if ((m_OrigHeight > windowHeight || (m_OrigWidth > windowWidth && m_OrigHeight > layoutHeight)) &&
-             (m_ZoomMode == ZoomMode::FIT_HEIGHT || (m_ZoomMode == ZoomMode::AUTO_FIT && windowAspect >= imageAspect)))
-    {
-        scaledHeight = std::ceil(windowHeight * imageAspect) > windowWidth && !hideScrollbars ? layoutHeight : windowHeight;
-        scaledWidth = std::ceil(scaledHeight * imageAspect);
-    }
-    else if (m_ZoomMode == ZoomMode::MANUAL && m_ZoomPercent != 100)
-    {
-        scaledWidth = m_OrigWidth * static_cast<double>(m_ZoomPercent) / 100;
-        scaledHeight = m_OrigHeight * static_cast<double>(m_ZoomPercent) / 100;
-    }
+        // Only fully loaded static images are cached, animations and
+        // images that are still loading are modified in place
+        bool cacheable = m_PixbufAnim->is_static_image() && !m_Loading;
+
+        // Scale from the smallest mipmap that is still larger than the result
+        Glib::RefPtr<Gdk::Pixbuf> srcPixbuf = cacheable ? m_Image->get_mipmap(scaledWidth, scaledHeight) : origPixbuf;
+
+        if (!srcPixbuf)
+            srcPixbuf = origPixbuf;
 
-    if (!m_Image->is_webm() && (scaledWidth != m_OrigWidth || scaledHeight != m_OrigHeight))
-        tempPixbuf = origPixbuf->scale_simple(scaledWidth, scaledHeight, Gdk::INTERP_BILINEAR);
+        if (m_TileImage != origPixbuf)
+            clear_tiles();
+
+        m_Tiled = cacheable && use_tiles(params, m_OrigWidth, m_OrigHeight, scaledWidth, scaledHeight);
+
+        if (m_Tiled)
+        {
+            m_TileImage    = origPixbuf;
+            m_TileSource   = srcPixbuf;
+            m_TiledWidth   = scaledWidth;
+            m_TiledHeight  = scaledHeight;
+        }
+        else if (scaledWidth != origPixbuf->get_width() || scaledHeight != origPixbuf->get_height())
+        {
+            // Images that were prescaled by the prefetcher only need a pointer swap
+            if (cacheable)
+                tempPixbuf = m_Image->get_scaled_pixbuf(scaledWidth, scaledHeight);
+
+            if (!tempPixbuf)
+            {
+                tempPixbuf = Scaler::scale(srcPixbuf, scaledWidth, scaledHeight);
+
+                if (cacheable)
+                    m_Image->set_scaled_pixbuf(tempPixbuf);
+            }
+        }
+        else
+        {
+            tempPixbuf = cacheable ? origPixbuf : origPixbuf->copy();
+        }
+    }
 
     // Show scrollbars if image is scrollable
     // or needed for padding in FIT_[WIDTH|HEIGHT]
@@ -520,7 +605,15 @@ void ImageBox::draw_image(bool scroll)
 
     m_Layout->set_size(scaledWidth, scaledHeight);
 
-    if (tempPixbuf)
+    if (m_Tiled)
+    {
+        // The tiles are drawn when the layout is exposed
+        m_GtkImage->clear();
+        m_TileX = x;
+        m_TileY = y;
+        m_Layout->queue_draw();
+    }
+    else if (tempPixbuf)
     {
         m_Layout->move(*m_GtkImage, x, y);
         m_GtkImage->set(tempPixbuf);
@@ -570,6 +663,177 @@ void ImageBox::draw_image(bool scroll)
 #endif // HAVE_GSTREAMER
 
     m_SignalImageDrawn();
+
+    if (scaleChanged)
+        m_SignalScaleChanged();
+}
+
+void ImageBox::get_scaled_size(const ScaleParams &params, const int origWidth, const int origHeight,
+                               int &scaledWidth, int &scaledHeight)
+{
+    double windowAspect = static_cast<double>(params.windowWidth) / params.windowHeight,
+           imageAspect  = static_cast<double>(origWidth) / origHeight;
+
+    scaledWidth  = origWidth;
+    scaledHeight = origHeight;
+
+    if ((origWidth > params.windowWidth || (origHeight > params.windowHeight && origWidth > params.layoutWidth)) &&
+        (params.zoomMode == ZoomMode::FIT_WIDTH || (params.zoomMode == ZoomMode::AUTO_FIT && windowAspect <= imageAspect)))
+    {
+        scaledWidth = std::ceil(params.windowWidth / imageAspect) > params.windowHeight && !params.hideScrollbars ?
+                        params.layoutWidth : params.windowWidth;
+        scaledHeight = std::ceil(scaledWidth / imageAspect);
+    }
+    else if ((origHeight > params.windowHeight || (origWidth > params.windowWidth && origHeight > params.layoutHeight)) &&
+             (params.zoomMode == ZoomMode::FIT_HEIGHT || (params.zoomMode == ZoomMode::AUTO_FIT && windowAspect >= imageAspect)))
+    {
+        scaledHeight = std::ceil(params.windowHeight * imageAspect) > params.windowWidth && !params.hideScrollbars ?
+                        params.layoutHeight : params.windowHeight;
+        scaledWidth = std::ceil(scaledHeight * imageAspect);
+    }
+    else if (params.zoomMode == ZoomMode::MANUAL && params.zoomPercent != 100)
+    {
+        scaledWidth = origWidth * static_cast<double>(params.zoomPercent) / 100;
+        scaledHeight = origHeight * static_cast<double>(params.zoomPercent) / 100;
+    }
+}
+
+bool ImageBox::use_tiles(const ScaleParams &params, const int origWidth, const int origHeight,
+                         const int scaledWidth, const int scaledHeight)
+{
+    // Scaling the whole image is cheap enough when it fits in the window
+    return params.zoomMode == ZoomMode::MANUAL &&
+           (scaledWidth != origWidth || scaledHeight != origHeight) &&
+           (scaledWidth > params.windowWidth || scaledHeight > params.windowHeight);
+}
+
+ImageBox::ScaleParams ImageBox::get_scale_params() const
+{
+    ScaleParams params;
+
+    m_MainWindow->get_drawable_area_size(params.windowWidth, params.windowHeight);
+    params.layoutWidth    = params.windowWidth - m_VScroll->size_request().width;
+    params.layoutHeight   = params.windowHeight - m_HScroll->size_request().height;
+    params.zoomMode       = m_ZoomMode;
+    params.zoomPercent    = m_ZoomPercent;
+    params.hideScrollbars = !Settings.get_bool("ScrollbarsVisible") ||
+                             Settings.get_bool("HideAll") || m_ZoomMode == ZoomMode::AUTO_FIT;
+
+    return params;
+}
+
+bool ImageBox::on_layout_expose_event(GdkEventExpose *e)
+{
+    if (!m_Tiled || e->window != m_Layout->get_bin_window()->gobj())
+        return false;
+
+    // Exposed area relative to the image
+    int x1 = std::max(e->area.x - m_TileX, 0),
+        y1 = std::max(e->area.y - m_TileY, 0),
+        x2 = std::min(e->area.x + e->area.width - m_TileX, m_TiledWidth),
+        y2 = std::min(e->area.y + e->area.height - m_TileY, m_TiledHeight);
+
+    if (x1 >= x2 || y1 >= y2)
+        return false;
+
+    Cairo::RefPtr<Cairo::Context> cr = m_Layout->get_bin_window()->create_cairo_context();
+    gdk_cairo_region(cr->cobj(), e->region);
+    cr->clip();
+
+    for (int row = y1 / TileSize; row <= (y2 - 1) / TileSize; ++row)
+    {
+        for (int col = x1 / TileSize; col <= (x2 - 1) / TileSize; ++col)
+        {
+            Glib::RefPtr<Gdk::Pixbuf> tile = get_tile(col, row);
+            int x = m_TileX + col * TileSize,
+                y = m_TileY + row * TileSize;
+
+            Gdk::Cairo::set_source_pixbuf(cr, tile, x, y);
+            cr->rectangle(x, y, tile->get_width(), tile->get_height());
+            cr->fill();
+        }
+    }
+
+    trim_tiles((x1 + x2) / 2 / TileSize, (y1 + y2) / 2 / TileSize);
+
+    return false;
+}
+
+Glib::RefPtr<Gdk::Pixbuf> ImageBox::get_tile(const int col, const int row)
+{
+    TileMap &tiles = m_Tiles[m_TiledWidth];
+    TileMap::iterator it = tiles.find(std::make_pair(col, row));
+
+    if (it != tiles.end())
+        return it->second;
+
+    int x = col * TileSize,
+        y = row * TileSize,
+        w = std::min(TileSize, m_TiledWidth - x),
+        h = std::min(TileSize, m_TiledHeight - y);
+
+    // Only the part of the source image that is under the tile is read
+    Glib::RefPtr<Gdk::Pixbuf> tile = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, m_TileSource->get_has_alpha(), 8, w, h);
+    m_TileSource->scale(tile, 0, 0, w, h, -x, -y,
+                        static_cast<double>(m_TiledWidth) / m_TileSource->get_width(),
+                        static_cast<double>(m_TiledHeight) / m_TileSource->get_height(),
+                        Gdk::INTERP_BILINEAR);
+
+    tiles[std::make_pair(col, row)] = tile;
+
+    return tile;
+}
+
+void ImageBox::trim_tiles(const int col, const int row)
+{
+    size_t n = 0;
+    for (const std::pair<const int, TileMap> &level : m_Tiles)
+        n += level.second.size();
+
+    if (n <= MaxTiles)
+        return;
+
+    // Other zoom levels go first
+    for (std::map<int, TileMap>::iterator it = m_Tiles.begin(); it != m_Tiles.end() && n > MaxTiles;)
+    {
+        if (it->first != m_TiledWidth)
+        {
+            n -= it->second.size();
+            it = m_Tiles.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    // Then the tiles farthest from the center of the exposed area
+    TileMap &tiles = m_Tiles[m_TiledWidth];
+    while (tiles.size() > MaxTiles)
+    {
+        TileMap::iterator farthest = tiles.begin();
+        int distance = -1;
+
+        for (TileMap::iterator it = tiles.begin(); it != tiles.end(); ++it)
+        {
+            int d = std::abs(it->first.first - col) + std::abs(it->first.second - row);
+            if (d > distance)
+            {
+                farthest = it;
+                distance = d;
+            }
+        }
+
+        tiles.erase(farthest);
+    }
+}
+
+void ImageBox::clear_tiles()
+{
+    m_Tiled = false;
+    m_TileImage.reset();
+    m_TileSource.reset();
+    m_Tiles.clear();
 }
 
 bool ImageBox::update_animation()
@@ -2,6 +2,7 @@
 #define _IMAGEBOX_H_
 
 #include <gtkmm.h>
+#include <map>
 
 #include "config.h"
 #include "image.h"
@@ -26,7 +27,16 @@ namespace AhoViewer
         };
 
         ImageBox(BaseObjectType*, const Glib::RefPtr<Gtk::Builder>&);
-        virtual ~ImageBox() override = default;
+        virtual ~ImageBox() override;
+
+        // Calculates the size an image of origWidth x origHeight would be drawn at
+        // with the current zoom mode and window size.
+        // This is thread safe, returns false if nothing has been drawn yet
+        // or if the image would be drawn in tiles.
+        bool get_scaled_size(const int origWidth, const int origHeight, int &w, int &h) const;
+        // Same as get_scaled_size, but only returns true when the image is fitted to the window
+        // and would be scaled down, i.e. it can be decoded at a reduced size.
+        bool get_decode_size(const int origWidth, const int origHeight, int &w, int &h) const;
 
         void queue_draw_image(const bool scroll = false);
         void set_image(const std::shared_ptr<Image> &image);
@@ -48,6 +58,8 @@ namespace AhoViewer
 
         sigc::signal<void> signal_slideshow_ended() const { return m_SignalSlideshowEnded; }
         sigc::signal<void> signal_image_drawn() const { return m_SignalImageDrawn; }
+        // Emitted when the size images are scaled to might have changed, e.g. the window was resized
+        sigc::signal<void> signal_scale_changed() const { return m_SignalScaleChanged; }
 
         // Action callbacks {{{
         void on_zoom_in();
@@ -66,6 +78,39 @@ namespace AhoViewer
         virtual bool on_motion_notify_event(GdkEventMotion *e) override;
         virtual bool on_scroll_event(GdkEventScroll *e) override;
     private:
+        // Everything that the scaled size of an image depends on
+        struct ScaleParams
+        {
+            bool operator==(const ScaleParams &rhs) const
+            {
+                return zoomMode == rhs.zoomMode && zoomPercent == rhs.zoomPercent &&
+                       windowWidth == rhs.windowWidth && windowHeight == rhs.windowHeight &&
+                       layoutWidth == rhs.layoutWidth && layoutHeight == rhs.layoutHeight &&
+                       hideScrollbars == rhs.hideScrollbars;
+            }
+            bool operator!=(const ScaleParams &rhs) const { return !(*this == rhs); }
+
+            ZoomMode zoomMode;
+            uint32_t zoomPercent;
+            int windowWidth, windowHeight,
+                layoutWidth, layoutHeight;
+            bool hideScrollbars;
+        };
+
+        // Tiles of a single zoom level, keyed by column and row
+        using TileMap = std::map<std::pair<int, int>, Glib::RefPtr<Gdk::Pixbuf>>;
+
+        static void get_scaled_size(const ScaleParams &params, const int origWidth, const int origHeight,
+                                    int &scaledWidth, int &scaledHeight);
+        static bool use_tiles(const ScaleParams &params, const int origWidth, const int origHeight,
+                              const int scaledWidth, const int scaledHeight);
+        ScaleParams get_scale_params() const;
+
+        bool on_layout_expose_event(GdkEventExpose *e);
+        Glib::RefPtr<Gdk::Pixbuf> get_tile(const int col, const int row);
+        void trim_tiles(const int col, const int row);
+        void clear_tiles();
+
         void draw_image(bool scroll);
         bool update_animation();
         void scroll(const int x, const int y, const bool panning = false, const bool fromSlideshow = false);
@@ -75,6 +120,9 @@ namespace AhoViewer
         bool advance_slideshow();
 
         static constexpr double SmoothScrollStep = 1000.0 / 60.0;
+        static const int TileSize = 256;
+        // Roughly 64MiB worth of RGBA tiles
+        static const size_t MaxTiles = 256;
 
         Gtk::Layout *m_Layout;
         Gtk::HScrollbar *m_HScroll;
@@ -105,12 +153,13 @@ namespace AhoViewer
         double m_Scale;
 
         std::shared_ptr<Image> m_Image;
+        // Set on m_Image, owned here so it's always destroyed on the main thread
+        Glib::Dispatcher m_SignalPixbufChanged;
         Glib::RefPtr<Gdk::PixbufAnimation> m_PixbufAnim;
         Glib::RefPtr<Gdk::PixbufAnimationIter> m_PixbufAnimIter;
         sigc::connection m_AnimConn,
                          m_CursorConn,
                          m_DrawConn,
-                         m_ImageConn,
                          m_ScrollConn,
                          m_SlideshowConn;
 
@@ -122,8 +171,23 @@ namespace AhoViewer
                m_ScrollTime, m_ScrollDuration,
                m_ScrollStart, m_ScrollTarget;
 
+        // Manually zoomed images that are larger than the window are drawn in tiles,
+        // only the tiles that are exposed get scaled. Tiles are kept for every zoom level
+        // of m_TileImage, keyed by the scaled width. m_TileSource is the mipmap of m_TileImage
+        // the current zoom level is scaled from.
+        Glib::RefPtr<Gdk::Pixbuf> m_TileImage, m_TileSource;
+        std::map<int, TileMap> m_Tiles;
+        bool m_Tiled;
+        int m_TileX, m_TileY,
+            m_TiledWidth, m_TiledHeight;
+
+        ScaleParams m_ScaleParams;
+        bool m_HasScaleParams;
+        mutable Glib::Threads::Mutex m_ScaleMutex;
+
         sigc::signal<void> m_SignalSlideshowEnded,
-                           m_SignalImageDrawn;
+                           m_SignalImageDrawn,
+                           m_SignalScaleChanged;
     };
 }
 
@@ -0,0 +1,160 @@
+#include <algorithm>
+
+#include "imagecache.h"
+using namespace AhoViewer;
+
+ImageCache::ImageCache()
+  : m_Budget(0),
+    m_Size(0)
+{
+
+}
+
+void ImageCache::set_budget(const size_t bytes)
+{
+    Glib::Threads::Mutex::Lock lock(m_Mutex);
+    m_Budget = bytes;
+}
+
+void ImageCache::touch(const std::shared_ptr<Image> &image)
+{
+    Glib::Threads::Mutex::Lock lock(m_Mutex);
+    std::map<const Image*, EntryList::iterator>::iterator it = m_Lookup.find(image.get());
+
+    if (it != m_Lookup.end())
+        m_Entries.splice(m_Entries.begin(), m_Entries, it->second);
+}
+
+void ImageCache::add(const std::shared_ptr<Image> &image)
+{
+    Glib::Threads::Mutex::Lock lock(m_Mutex);
+    std::map<const Image*, EntryList::iterator>::iterator it = m_Lookup.find(image.get());
+
+    if (it != m_Lookup.end())
+    {
+        // The image could have gained a scaled copy or mipmaps since it was added
+        m_Size -= it->second->size;
+        it->second->size = 0;
+        m_Entries.splice(m_Entries.begin(), m_Entries, it->second);
+    }
+    else
+    {
+        m_Entries.push_front({ image, 0 });
+        m_Lookup[image.get()] = m_Entries.begin();
+    }
+
+    trim_unlocked();
+}
+
+ImageCache::ImageVector ImageCache::fit(const ImageVector &window) const
+{
+    Glib::Threads::Mutex::Lock lock(m_Mutex);
+    size_t total = 0, n = 0;
+
+    for (const Entry &e : m_Entries)
+    {
+        if (e.size)
+        {
+            total += e.size;
+            ++n;
+        }
+    }
+
+    // Nothing is known about the size of the images yet
+    if (n == 0)
+        return window;
+
+    size_t estimate = total / n,
+           size     = 0;
+    ImageVector fitted;
+
+    for (const std::shared_ptr<Image> &img : window)
+    {
+        std::map<const Image*, EntryList::iterator>::const_iterator it = m_Lookup.find(img.get());
+        size += it != m_Lookup.end() && it->second->size ? it->second->size : estimate;
+
+        // Always keep the current image
+        if (size > m_Budget && !fitted.empty())
+            break;
+
+        fitted.push_back(img);
+    }
+
+    return fitted;
+}
+
+ImageCache::ImageVector ImageCache::trim(const ImageVector &window)
+{
+    Glib::Threads::Mutex::Lock lock(m_Mutex);
+    m_Window = window;
+    trim_unlocked();
+
+    return m_Window;
+}
+
+void ImageCache::clear()
+{
+    Glib::Threads::Mutex::Lock lock(m_Mutex);
+    m_Entries.clear();
+    m_Lookup.clear();
+    m_Window.clear();
+    m_Size = 0;
+}
+
+void ImageCache::trim_unlocked()
+{
+    // Booru images are still downloading when they are added
+    for (Entry &e : m_Entries)
+        update_size(e);
+
+    if (m_Size <= m_Budget)
+        return;
+
+    std::vector<EntryList::iterator> victims;
+
+    // Images that are not in the window, least recently used first
+    for (EntryList::iterator it = m_Entries.begin(); it != m_Entries.end(); ++it)
+        if (std::find(m_Window.begin(), m_Window.end(), it->image) == m_Window.end())
+            victims.push_back(it);
+    std::reverse(victims.begin(), victims.end());
+
+    const size_t outside = victims.size();
+    std::vector<size_t> rows;
+
+    // Then the images in the window, farthest from the current image first
+    for (size_t i = m_Window.size(); i-- > 1;)
+    {
+        std::map<const Image*, EntryList::iterator>::iterator it = m_Lookup.find(m_Window[i].get());
+        if (it != m_Lookup.end())
+        {
+            victims.push_back(it->second);
+            rows.push_back(i);
+        }
+    }
+
+    size_t kept = m_Window.size();
+
+    for (size_t i = 0; i < victims.size() && m_Size > m_Budget; ++i)
+    {
+        EntryList::iterator it = victims[i];
+
+        if (i >= outside)
+            kept = rows[i - outside];
+
+        it->image->reset_pixbuf();
+        m_Size -= it->size;
+        m_Lookup.erase(it->image.get());
+        m_Entries.erase(it);
+    }
+
+    m_Window.resize(kept);
+}
+
+void ImageCache::update_size(Entry &e)
+{
+    if (e.size == 0)
+    {
+        e.size = e.image->get_pixbuf_size();
+        m_Size += e.size;
+    }
+}
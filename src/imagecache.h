@@ -0,0 +1,64 @@
+#ifndef _IMAGECACHE_H_
+#define _IMAGECACHE_H_
+
+#include <glibmm.h>
+#include <list>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "image.h"
+
+namespace AhoViewer
+{
+    // Keeps track of the decoded images of an ImageList and the memory they use.
+    // When the total size goes over the budget images are evicted, the ones outside
+    // of the cache window first (least recently used), then the ones in the window
+    // that are farthest from the current image.
+    class ImageCache
+    {
+        using ImageVector = std::vector<std::shared_ptr<Image>>;
+    public:
+        ImageCache();
+
+        void set_budget(const size_t bytes);
+
+        // Called when image becomes the current image, marks it as recently used
+        void touch(const std::shared_ptr<Image> &image);
+        // Called once an image has been decoded, or when more copies of it have been made.
+        void add(const std::shared_ptr<Image> &image);
+
+        // Returns the part of the window that is expected to fit in the budget.
+        // Sizes of images that are not decoded yet are estimated from the cached ones.
+        ImageVector fit(const ImageVector &window) const;
+        // Evicts images until the cache is under its budget,
+        // window should be sorted by priority, window[0] is never evicted.
+        // Returns the part of the window that was kept, images past the first
+        // one that was evicted wouldn't fit either and shouldn't be decoded.
+        ImageVector trim(const ImageVector &window);
+
+        void clear();
+    private:
+        struct Entry
+        {
+            std::shared_ptr<Image> image;
+            size_t size;
+        };
+        using EntryList = std::list<Entry>;
+
+        // Evicts from m_Window and shrinks it to the images that were kept
+        void trim_unlocked();
+        void update_size(Entry &e);
+
+        // Most recently used first
+        EntryList m_Entries;
+        std::map<const Image*, EntryList::iterator> m_Lookup;
+        ImageVector m_Window;
+
+        size_t m_Budget, m_Size;
+
+        mutable Glib::Threads::Mutex m_Mutex;
+    };
+}
+
+#endif /* _IMAGECACHE_H_ */
@@ -0,0 +1,311 @@
+#include <cstring>
+
+#include "imagecatalog.h"
+using namespace AhoViewer;
+
+#include "naturalsort.h"
+
+const guint32 ImageCatalog::ProbeId;
+
+ImageCatalog::ImageCatalog(const ImageFunc &func)
+  : m_ImageFunc(func),
+    m_PathIds(0, EntryHash { this }, EntryEqual { this }),
+    m_ProbeDir(0)
+{
+
+}
+
+void ImageCatalog::clear()
+{
+    Glib::Threads::Mutex::Lock lock(m_Mutex);
+
+    m_Rows.clear();
+    m_PathIds.clear();
+    m_EntryDirs.clear();
+    m_NameOffsets.clear();
+    m_NameLengths.clear();
+    m_KeyOffsets.clear();
+    m_KeyLengths.clear();
+    m_Images.clear();
+    m_Names.clear();
+    m_Keys.clear();
+    m_Dirs.clear();
+    m_DirKeys.clear();
+    m_DirIds.clear();
+    m_Pinned.clear();
+}
+
+void ImageCatalog::reserve(const size_t n)
+{
+    m_Rows.reserve(n);
+    m_EntryDirs.reserve(n);
+    m_NameOffsets.reserve(n);
+    m_NameLengths.reserve(n);
+    m_KeyOffsets.reserve(n);
+    m_KeyLengths.reserve(n);
+    m_Images.reserve(n);
+    m_PathIds.reserve(n);
+    // Most file names are shorter than this
+    m_Names.reserve(n * 24);
+    m_Keys.reserve(n * 24);
+}
+
+void ImageCatalog::push_back(const std::string &path, const std::string &key)
+{
+    m_Rows.push_back(add_entry(path, key));
+}
+
+void ImageCatalog::push_back(const std::shared_ptr<Image> &image)
+{
+    guint32 id = add_entry(image->get_path(), std::string());
+
+    m_Rows.push_back(id);
+    m_Images[id] = image;
+    m_Pinned.push_back(image);
+}
+
+std::shared_ptr<Image> ImageCatalog::get(const size_t row)
+{
+    const guint32 id = m_Rows[row];
+    Glib::Threads::Mutex::Lock lock(m_Mutex);
+    std::shared_ptr<Image> image = m_Images[id].lock();
+
+    // Created while the mutex is held, two threads never create the same entry
+    if (!image)
+    {
+        image = m_ImageFunc(get_entry_path(id));
+        m_Images[id] = image;
+    }
+
+    return image;
+}
+
+std::string ImageCatalog::get_path(const size_t row) const
+{
+    return get_entry_path(m_Rows[row]);
+}
+
+size_t ImageCatalog::find(const std::string &path) const
+{
+    if (!set_probe(path))
+        return size();
+
+    auto it = m_PathIds.find(ProbeId);
+    if (it == m_PathIds.end())
+        return size();
+
+    // Paths whose keys are equal ("01" and "1") are next to each other
+    size_t row = lower_bound(NaturalSort::make_key(path));
+    while (row < size() && m_Rows[row] != *it)
+        ++row;
+
+    return row;
+}
+
+bool ImageCatalog::contains(const std::string &path) const
+{
+    return set_probe(path) && m_PathIds.count(ProbeId);
+}
+
+size_t ImageCatalog::lower_bound(const std::string &key, size_t first) const
+{
+    size_t count = size() - first;
+
+    while (count > 0)
+    {
+        size_t step = count / 2,
+               row  = first + step;
+
+        if (compare_key(key, m_Rows[row]) > 0)
+        {
+            first = row + 1;
+            count -= step + 1;
+        }
+        else
+        {
+            count = step;
+        }
+    }
+
+    return first;
+}
+
+std::vector<size_t> ImageCatalog::merge(const std::vector<std::string> &paths, const std::vector<std::string> &keys,
+                                        const std::vector<size_t> &removed, std::vector<size_t> &rows)
+{
+    // Where each path goes among the old rows, the paths are sorted
+    // so each search starts where the last one ended
+    std::vector<size_t> positions;
+    positions.reserve(paths.size());
+
+    for (const std::string &k : keys)
+        positions.push_back(lower_bound(k, positions.empty() ? 0 : positions.back()));
+
+    std::vector<guint32> merged;
+    std::vector<size_t> inserted;
+    auto r = removed.begin();
+    size_t a = 0;
+
+    merged.reserve(m_Rows.size() - removed.size() + paths.size());
+    rows.assign(m_Rows.size(), static_cast<size_t>(RemovedRow));
+
+    auto insert = [ & ]()
+    {
+        inserted.push_back(merged.size());
+        merged.push_back(add_entry(paths[a], keys[a]));
+        ++a;
+    };
+
+    for (size_t i = 0; i < m_Rows.size(); ++i)
+    {
+        while (a < paths.size() && positions[a] <= i)
+            insert();
+
+        if (r != removed.end() && *r == i)
+        {
+            remove_entry(m_Rows[i]);
+            ++r;
+            continue;
+        }
+
+        rows[i] = merged.size();
+        merged.push_back(m_Rows[i]);
+    }
+
+    while (a < paths.size())
+        insert();
+
+    m_Rows.swap(merged);
+
+    return inserted;
+}
+
+size_t ImageCatalog::EntryHash::operator()(const guint32 id) const
+{
+    guint32 dir;
+    const char *name;
+    size_t length;
+    catalog->get_name(id, dir, name, length);
+
+    // FNV-1a of the name, then the directory id
+    size_t h = 2166136261u;
+    for (size_t i = 0; i < length; ++i)
+        h = (h ^ static_cast<unsigned char>(name[i])) * 16777619u;
+
+    return (h ^ dir) * 16777619u;
+}
+
+bool ImageCatalog::EntryEqual::operator()(const guint32 a, const guint32 b) const
+{
+    guint32 aDir, bDir;
+    const char *aName, *bName;
+    size_t aLength, bLength;
+    catalog->get_name(a, aDir, aName, aLength);
+    catalog->get_name(b, bDir, bName, bLength);
+
+    return aDir == bDir && aLength == bLength && memcmp(aName, bName, aLength) == 0;
+}
+
+guint32 ImageCatalog::add_entry(const std::string &path, const std::string &key)
+{
+    // The directory keeps its trailing separator, the path is the directory and the name put together
+    size_t s = path.find_last_of("/" G_DIR_SEPARATOR_S);
+    size_t n = s == std::string::npos ? 0 : s + 1;
+    std::string dir = path.substr(0, n);
+
+    auto it = m_DirIds.find(dir);
+    if (it == m_DirIds.end())
+    {
+        it = m_DirIds.emplace(dir, m_Dirs.size()).first;
+        m_Dirs.push_back(dir);
+
+        std::string dirKey = NaturalSort::make_key(dir);
+        dirKey.pop_back();
+        m_DirKeys.push_back(std::move(dirKey));
+    }
+
+    guint32 id = m_EntryDirs.size();
+
+    m_EntryDirs.push_back(it->second);
+    m_NameOffsets.push_back(m_Names.size());
+    m_NameLengths.push_back(path.size() - n);
+    m_Names.append(path, n, std::string::npos);
+
+    m_KeyOffsets.push_back(m_Keys.size());
+    if (key.empty())
+        m_Keys += NaturalSort::make_key(path.substr(n));
+    else
+        m_Keys.append(key, m_DirKeys[it->second].size(), std::string::npos);
+    m_KeyLengths.push_back(m_Keys.size() - m_KeyOffsets.back());
+
+    {
+        Glib::Threads::Mutex::Lock lock(m_Mutex);
+        m_Images.emplace_back();
+    }
+
+    m_PathIds.insert(id);
+
+    return id;
+}
+
+void ImageCatalog::remove_entry(const guint32 id)
+{
+    m_PathIds.erase(id);
+
+    // An image that is still shown or cached stays alive until it's released
+    Glib::Threads::Mutex::Lock lock(m_Mutex);
+    m_Images[id].reset();
+}
+
+std::string ImageCatalog::get_entry_path(const guint32 id) const
+{
+    const std::string &dir = m_Dirs[m_EntryDirs[id]];
+    std::string path;
+
+    path.reserve(dir.size() + m_NameLengths[id]);
+    path += dir;
+    path.append(m_Names, m_NameOffsets[id], m_NameLengths[id]);
+
+    return path;
+}
+
+bool ImageCatalog::set_probe(const std::string &path) const
+{
+    size_t s = path.find_last_of("/" G_DIR_SEPARATOR_S);
+    size_t n = s == std::string::npos ? 0 : s + 1;
+
+    auto it = m_DirIds.find(path.substr(0, n));
+    if (it == m_DirIds.end())
+        return false;
+
+    m_ProbeDir  = it->second;
+    m_ProbeName = path.substr(n);
+
+    return true;
+}
+
+void ImageCatalog::get_name(const guint32 id, guint32 &dir, const char *&name, size_t &length) const
+{
+    if (id == ProbeId)
+    {
+        dir    = m_ProbeDir;
+        name   = m_ProbeName.data();
+        length = m_ProbeName.size();
+    }
+    else
+    {
+        dir    = m_EntryDirs[id];
+        name   = m_Names.data() + m_NameOffsets[id];
+        length = m_NameLengths[id];
+    }
+}
+
+int ImageCatalog::compare_key(const std::string &key, const guint32 id) const
+{
+    const std::string &dirKey = m_DirKeys[m_EntryDirs[id]];
+
+    if (int c = key.compare(0, dirKey.size(), dirKey))
+        return c;
+
+    return key.compare(dirKey.size(), std::string::npos, m_Keys, m_KeyOffsets[id], m_KeyLengths[id]);
+}
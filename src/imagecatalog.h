@@ -0,0 +1,116 @@
+#ifndef _IMAGECATALOG_H_
+#define _IMAGECATALOG_H_
+
+#include <functional>
+#include <glibmm.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "image.h"
+
+namespace AhoViewer
+{
+    // The rows of an ImageList.
+    //
+    // Entries are stored as struct of arrays, the path of an entry is the id of its directory
+    // and the offset of its file name in one string arena, so a directory isn't repeated in
+    // every path. The NaturalSort key of an entry is kept the same way, the key of its
+    // directory once and the key of its file name in a second arena. Their Image objects are created by get() and only live as long as something
+    // else holds them, ie while they are current, cached or having their thumbnail loaded.
+    //
+    // Booru images are added as Image objects and kept until the catalog is cleared.
+    class ImageCatalog
+    {
+        using ImageVector = std::vector<std::shared_ptr<Image>>;
+    public:
+        // Creates the Image of a path added with push_back
+        using ImageFunc = std::function<std::shared_ptr<Image>(const std::string&)>;
+
+        ImageCatalog(const ImageFunc &func);
+
+        size_t size() const { return m_Rows.size(); }
+        bool empty() const { return m_Rows.empty(); }
+        void clear();
+        void reserve(const size_t n);
+
+        // key is the NaturalSort key of path, it's built if it's empty
+        void push_back(const std::string &path, const std::string &key = std::string());
+        void push_back(const std::shared_ptr<Image> &image);
+
+        // Returns the image of row, creating it if nothing holds it.
+        // Can be called from any thread while no rows are added or removed.
+        std::shared_ptr<Image> get(const size_t row);
+        std::shared_ptr<Image> operator[](const size_t row) { return get(row); }
+        std::string get_path(const size_t row) const;
+
+        // Returns the row of path, or size() if it isn't in the catalog. Main thread only.
+        size_t find(const std::string &path) const;
+        bool contains(const std::string &path) const;
+        // Returns the first row whose NaturalSort key isn't lower than key
+        size_t lower_bound(const std::string &key, size_t first = 0) const;
+
+        // Removes the rows in removed (ascending) and merges in the sorted paths whose
+        // NaturalSort keys are keys. Sets rows to the new row of each old row (RemovedRow
+        // if it was removed) and returns the rows of the added paths.
+        std::vector<size_t> merge(const std::vector<std::string> &paths, const std::vector<std::string> &keys,
+                                  const std::vector<size_t> &removed, std::vector<size_t> &rows);
+
+        // The booru images, local images aren't kept
+        ImageVector::iterator begin() { return m_Pinned.begin(); }
+        ImageVector::iterator end() { return m_Pinned.end(); }
+
+        static const size_t RemovedRow = static_cast<size_t>(-1);
+    private:
+        // Hash and equality of entry ids by path, ProbeId stands for the path being looked up
+        struct EntryHash
+        {
+            const ImageCatalog *catalog;
+            size_t operator()(const guint32 id) const;
+        };
+        struct EntryEqual
+        {
+            const ImageCatalog *catalog;
+            bool operator()(const guint32 a, const guint32 b) const;
+        };
+
+        // Returns the id of the new entry
+        guint32 add_entry(const std::string &path, const std::string &key);
+        void remove_entry(const guint32 id);
+        std::string get_entry_path(const guint32 id) const;
+        // Splits path after its last separator, returns false if its directory isn't known
+        bool set_probe(const std::string &path) const;
+        void get_name(const guint32 id, guint32 &dir, const char *&name, size_t &length) const;
+        // Compares key with the key of the entry like std::string::compare
+        int compare_key(const std::string &key, const guint32 id) const;
+
+        ImageFunc m_ImageFunc;
+
+        // Entry ids in row order, ids aren't reused until the catalog is cleared
+        std::vector<guint32> m_Rows;
+
+        // Indexed by entry id. The names of removed entries stay in m_Names.
+        std::vector<guint32> m_EntryDirs, m_NameOffsets, m_NameLengths,
+                             m_KeyOffsets, m_KeyLengths;
+        std::vector<std::weak_ptr<Image>> m_Images;
+        std::string m_Names, m_Keys;
+
+        // A directory ends with a separator, no number runs past it, so the key of
+        // a path is the key of its directory without the end mark followed by the key of its name
+        std::vector<std::string> m_Dirs, m_DirKeys;
+        std::unordered_map<std::string, guint32> m_DirIds;
+        std::unordered_set<guint32, EntryHash, EntryEqual> m_PathIds;
+
+        mutable guint32 m_ProbeDir;
+        mutable std::string m_ProbeName;
+
+        ImageVector m_Pinned;
+        mutable Glib::Threads::Mutex m_Mutex;
+
+        static const guint32 ProbeId = static_cast<guint32>(-1);
+    };
+}
+
+#endif /* _IMAGECATALOG_H_ */
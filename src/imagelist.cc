@@ -1,34 +1,52 @@
 #include <glib/gstdio.h>
-#include <numeric>
+#include <algorithm>
+#include <iostream>
 
 #include "imagelist.h"
 using namespace AhoViewer;
 
 #include "booru/image.h"
+#include "formats.h"
 #include "naturalsort.h"
 #include "settings.h"
 
 ImageList::ImageList(Widget *const w)
   : m_Widget(w),
+    m_Images([ this ](const std::string &path) -> std::shared_ptr<Image>
+    {
+        if (m_Archive)
+            return std::make_shared<Archive::Image>(path, *m_Archive);
+
+        return std::make_shared<Image>(path);
+    }),
     m_Index(0),
     m_ThumbnailCancel(Gio::Cancellable::create()),
     m_ThumbnailThread(nullptr),
-    m_CacheCancel(Gio::Cancellable::create()),
-    m_CacheThread(nullptr)
+    m_ScanThread(nullptr),
+    m_ScanCancel(Gio::Cancellable::create()),
+    m_ScanChecked(0),
+    m_ScanTotal(0),
+    m_ScanDone(false),
+    m_MonitorThread(nullptr),
+    m_ThumbnailDraining(false),
+    m_ThumbnailMemory(0),
+    m_ThumbnailRestart(false),
+    m_DirectionScore(0),
+    m_Velocity(0.0),
+    m_Slideshow(false),
+    m_Prefetcher(m_Cache)
 {
-    // Sorts indices based on how close they are to m_Index
-    m_IndexSort = [ this ](size_t a, size_t b)
-    {
-        size_t adiff = std::abs(static_cast<int>(a - m_Index)),
-               bdiff = std::abs(static_cast<int>(b - m_Index));
-        return adiff == bdiff ? a > b : adiff < bdiff;
-    };
-
     m_Widget->signal_selected_changed().connect(
             sigc::bind(sigc::mem_fun(*this, &ImageList::set_current), true, false));
+    m_Widget->signal_visible_range_changed().connect(
+            sigc::mem_fun(*this, &ImageList::on_visible_range_changed));
+    m_Widget->m_Model->set_pixbuf_func([ this ](const size_t i) { return get_row_thumbnail(i); });
 
-    m_ThumbnailLoadedConn = m_SignalThumbnailLoaded.connect(sigc::mem_fun(*this, &ImageList::on_thumbnail_loaded));
+    m_SignalThumbnailLoaded.connect(sigc::mem_fun(*this, &ImageList::on_thumbnail_loaded));
     m_SignalThumbnailsLoaded.connect(sigc::mem_fun(*this, &ImageList::on_thumbnails_loaded));
+    m_SignalEntriesScanned.connect(sigc::mem_fun(*this, &ImageList::on_entries_scanned));
+    m_SignalScanFinished.connect(sigc::mem_fun(*this, &ImageList::on_scan_finished));
+    m_SignalFilesChecked.connect(sigc::mem_fun(*this, &ImageList::on_files_checked));
 }
 
 ImageList::~ImageList()
@@ -77,8 +95,37 @@ bool ImageList::load(const Glib::ustring path, std::string &error, int index)
         return false;
     }
 
-    std::vector<std::string> entries =
-        archive ? archive->get_entries(Archive::IMAGES) : get_entries<Image>(dirPath);
+    // The requested image is shown right away and the rest of
+    // the directory is added to the list while it's being scanned
+    if (path != dirPath && !archive)
+    {
+        m_SignalLoadSuccess();
+        reset();
+
+        m_Images.push_back(path.raw());
+        m_Widget->reserve(1);
+        set_current(0, false, true);
+
+        m_DirIndex = std::unique_ptr<DirIndex>(new DirIndex(dirPath));
+        m_ScanThread = Glib::Threads::Thread::create(
+                sigc::bind(sigc::mem_fun(*this, &ImageList::scan_directory), dirPath.raw()));
+
+        return true;
+    }
+
+    std::vector<std::string> entries;
+    std::unique_ptr<DirIndex> dirIndex;
+
+    if (archive)
+    {
+        entries = archive->get_entries(Archive::IMAGES);
+    }
+    else
+    {
+        // A directory that hasn't changed since it was last opened isn't scanned again
+        dirIndex = std::unique_ptr<DirIndex>(new DirIndex(dirPath));
+        entries = dirIndex->load() ? dirIndex->get_paths() : get_entries<Image>(dirPath);
+    }
 
     // No valid images in this directory
     if (entries.empty())
@@ -99,7 +146,7 @@ bool ImageList::load(const Glib::ustring path, std::string &error, int index)
     {
         m_Archive = std::move(archive);
         m_ArchiveEntries = get_entries<Archive>(Glib::path_get_dirname(m_Archive->get_path()));
-        std::sort(m_ArchiveEntries.begin(), m_ArchiveEntries.end(), NaturalSort());
+        NaturalSort::sort(m_ArchiveEntries);
     }
     else
     {
@@ -108,29 +155,26 @@ bool ImageList::load(const Glib::ustring path, std::string &error, int index)
         m_FileMonitor->signal_changed().connect(sigc::mem_fun(*this, &ImageList::on_directory_changed));
     }
 
-    std::sort(entries.begin(), entries.end(), NaturalSort());
-
-    if (path != dirPath && !m_Archive)
+    // Entries from the index are already sorted, their keys are built when they're added
+    std::vector<std::string> keys;
+    if (!dirIndex || dirIndex->empty())
     {
-        std::vector<std::string>::iterator iter = std::find(entries.begin(), entries.end(), path);
-        index = iter == entries.end() ? 0 : iter - entries.begin();
+        NaturalSort::sort(entries, &keys);
+
+        if (dirIndex)
+            dirIndex->save(entries);
     }
-    else if (index == -1)
+
+    if (index == -1)
     {
         index = entries.size() - 1;
     }
 
-    for (const std::string &e : entries)
-    {
-        std::shared_ptr<Image> img;
-        if (m_Archive)
-            img = std::make_shared<Archive::Image>(e, *m_Archive);
-        else
-            img = std::make_shared<Image>(e);
-        m_Images.push_back(std::move(img));
-    }
+    // The images are created once they are needed
+    for (size_t i = 0; i < entries.size(); ++i)
+        m_Images.push_back(entries[i], keys.empty() ? std::string() : keys[i]);
 
-    m_ThumbnailThread = Glib::Threads::Thread::create(sigc::mem_fun(*this, &ImageList::load_thumbnails));
+    start_thumbnails(index);
     set_current(index, false, true);
 
     return true;
@@ -148,17 +192,21 @@ void ImageList::go_previous()
 
 void ImageList::go_first()
 {
-    set_current(0);
+    if (!is_scanning())
+        set_current(0);
 }
 
 void ImageList::go_last()
 {
-    set_current(m_Images.size() - 1);
+    if (!is_scanning())
+        set_current(m_Images.size() - 1);
 }
 
 bool ImageList::can_go_next() const
 {
-    if (m_Index + 1 < m_Images.size())
+    if (is_scanning())
+        return false;
+    else if (m_Index + 1 < m_Images.size())
         return true;
     else if (m_Archive && Settings.get_bool("AutoOpenArchive"))
         return std::find(m_ArchiveEntries.begin(), m_ArchiveEntries.end(),
@@ -169,7 +217,9 @@ bool ImageList::can_go_next() const
 
 bool ImageList::can_go_previous() const
 {
-    if (m_Index > 0)
+    if (is_scanning())
+        return false;
+    else if (m_Index > 0)
         return true;
     else if (m_Archive && Settings.get_bool("AutoOpenArchive"))
         return std::find(m_ArchiveEntries.begin(), m_ArchiveEntries.end(),
@@ -184,47 +234,80 @@ void ImageList::on_cache_size_changed()
         update_cache();
 }
 
+void ImageList::on_scale_size_changed()
+{
+    if (!empty())
+        update_cache();
+}
+
+void ImageList::set_slideshow(const bool running)
+{
+    if (m_Slideshow != running)
+    {
+        m_Slideshow = running;
+
+        if (!empty())
+            update_cache();
+    }
+}
+
 void ImageList::set_current(const size_t index, const bool fromWidget, const bool force)
 {
     if (index == m_Index && !force)
         return;
 
+    update_navigation(index);
     m_Index = index;
-    m_SignalChanged(m_Images[m_Index]);
+    m_Current = m_Images.get(m_Index);
+    m_Cache.touch(m_Current);
+    m_SignalChanged(m_Current);
     update_cache();
 
     if (!fromWidget)
         m_Widget->set_selected(m_Index);
 }
 
+void ImageList::start_thumbnails(const size_t center)
+{
+    {
+        Glib::Threads::Mutex::Lock lock(m_ThumbnailMutex);
+        m_ThumbnailTaken.resize(m_Images.size(), false);
+    }
+
+    set_thumbnail_center(center);
+    m_ThumbnailThread = Glib::Threads::Thread::create(sigc::mem_fun(*this, &ImageList::load_thumbnails));
+}
+
 void ImageList::load_thumbnails()
 {
-    Glib::ThreadPool pool(4);
+    // Thumbnailing is mostly spent decoding, one worker per core
+    const size_t n = std::max(static_cast<int>(g_get_num_processors()), 2);
+    Glib::ThreadPool pool(n);
     m_ThumbnailCancel->reset();
 
-    std::vector<size_t> indices(m_Images.size());
-    std::iota(indices.begin(), indices.end(), 0);
-    std::sort(indices.begin(), indices.end(), m_IndexSort);
-
-    for (const size_t i : indices)
+    // Each worker asks for the next most important thumbnail
+    // so the order can change while the thumbnails are loading
+    for (size_t i = 0; i < n; ++i)
     {
-        pool.push([ this, i ]()
+        pool.push([ this ]()
         {
-            if (m_ThumbnailCancel->is_cancelled())
-                return;
+            size_t i;
 
-            const Glib::RefPtr<Gdk::Pixbuf> &thumb = m_Images[i]->get_thumbnail();
+            while (!m_ThumbnailCancel->is_cancelled() && next_thumbnail(i))
             {
-                Glib::Threads::Mutex::Lock lock(m_ThumbnailMutex);
-                m_ThumbnailQueue.push(PixbufPair(i, thumb));
+                // Only the first thumbnail pushed to an empty queue wakes up the main thread.
+                // It's sent even when cancelled, otherwise whatever is left in the queue is
+                // never popped and later pushes never see an empty queue again.
+                std::shared_ptr<Image> image = m_Images.get(i);
+                Glib::RefPtr<Gdk::Pixbuf> pixbuf = image->get_thumbnail();
+
+                if (m_ThumbnailQueue.push({ i, std::move(image), pixbuf }))
+                    m_SignalThumbnailLoaded();
             }
-
-            if (!m_ThumbnailCancel->is_cancelled())
-                m_SignalThumbnailLoaded();
         });
     }
 
-    pool.shutdown(m_ThumbnailCancel->is_cancelled());
+    pool.shutdown();
 
     if (!m_ThumbnailCancel->is_cancelled())
         m_SignalThumbnailsLoaded();
@@ -235,75 +318,545 @@ void ImageList::reset()
 {
     cancel_cache();
     m_ThumbnailCancel->cancel();
+    m_ScanCancel->cancel();
 
     if (m_FileMonitor)
         m_FileMonitor->cancel();
 
-    {
-        Glib::Threads::Mutex::Lock lock(m_ThumbnailMutex);
-        m_ThumbnailQueue = std::queue<PixbufPair>();
-    }
-
     if (m_ThumbnailThread)
     {
         m_ThumbnailThread->join();
         m_ThumbnailThread = nullptr;
     }
 
+    if (m_ScanThread)
+    {
+        m_ScanThread->join();
+        m_ScanThread = nullptr;
+    }
+
+    if (m_MonitorThread)
+    {
+        m_MonitorThread->join();
+        m_MonitorThread = nullptr;
+    }
+
+    m_ScanCancel->reset();
+    m_ScanQueue.clear();
+    m_ScanChecked = m_ScanTotal = 0;
+    m_ScanDone = false;
+
+    m_MonitorConn.disconnect();
+    m_MonitorEvents.clear();
+    m_MonitorChecking.clear();
+    m_MonitorValid.clear();
+
+    m_DirIndex = nullptr;
+
+    m_ThumbnailQueue.clear();
+    m_ThumbnailPending.clear();
+    m_ThumbnailDrainConn.disconnect();
+
+    m_ThumbnailTaken.clear();
+    m_ThumbnailShown.clear();
+    m_ThumbnailResident.clear();
+    m_ThumbnailEvicted.clear();
+    m_ThumbnailImages.clear();
+    m_ThumbnailPlaceholders.clear();
+    m_ThumbnailMemory = 0;
+    m_ThumbnailRestart = false;
+
     m_Images.clear();
+    m_Current = nullptr;
     m_Widget->clear();
 
     m_Archive = nullptr;
     m_ArchiveEntries.clear();
     m_Index = 0;
+
+    m_DirectionScore = 0;
+    m_Velocity = 0.0;
 }
 
 /**
  * Returns an unsorted vector of the paths to valid T's.
- * T must have a static method ::is_valid, ie Image and Archive
+ * T must have the static methods ::is_valid and ::is_valid_extension, ie Image and Archive
  **/
 template <typename T>
 std::vector<std::string> ImageList::get_entries(const std::string &path)
+{
+    std::vector<std::string> entries;
+
+    scan_entries<T>(path, [ & ](std::vector<std::string> &&found, const size_t checked, const size_t total)
+    {
+        entries.insert(entries.end(), std::make_move_iterator(found.begin()), std::make_move_iterator(found.end()));
+
+        if (total > 0)
+            m_SignalScanProgress(checked, total);
+    });
+
+    return entries;
+}
+
+/**
+ * Passes the paths to valid T's in path to found, a few at a time.
+ *
+ * Files are accepted or rejected by their extension, only files without a
+ * known extension are opened to check them (unless TrustExtensions is set).
+ * Those checks run on a thread pool, they can take a while on network drives.
+ **/
+template <typename T>
+void ImageList::scan_entries(const std::string &path, const ScanFunc &found,
+                             const Glib::RefPtr<Gio::Cancellable> &cancellable)
 {
     Glib::Dir dir(path);
-    std::vector<std::string> entries(dir.begin(), dir.end());
-    std::vector<std::string>::iterator i = entries.begin();
+    const bool trust = Settings.get_bool("TrustExtensions");
+    std::vector<std::string> entries, unknown;
 
-    while (i != entries.end())
+    for (const std::string &e : dir)
     {
-        // Make path absolute
-        *i = Glib::build_filename(path, *i);
+        std::string p = Glib::build_filename(path, e);
 
-        // Make sure it is a loadable image/archive
-        if (T::is_valid(*i))
-            ++i;
-        else
-            i = entries.erase(i);
+        if (T::is_valid_extension(p))
+            entries.push_back(std::move(p));
+        else if (!trust && !Formats::get_instance().find(p))
+            unknown.push_back(std::move(p));
     }
 
-    return entries;
+    found(std::move(entries), 0, unknown.size());
+
+    if (unknown.empty())
+        return;
+
+    Glib::Threads::Mutex mutex;
+    Glib::Threads::Cond cond;
+    std::vector<char> valid(unknown.size(), false);
+    // Indices of unknown that were checked since found was last called
+    std::vector<size_t> done;
+    size_t checked = 0;
+    {
+        // Mostly waiting on the disk or network, more threads than cores help
+        Glib::ThreadPool pool(std::max(static_cast<int>(g_get_num_processors()) * 2, 8));
+
+        for (size_t i = 0; i < unknown.size(); ++i)
+        {
+            pool.push([ &, i ]()
+            {
+                if (!cancellable || !cancellable->is_cancelled())
+                    valid[i] = T::is_valid(unknown[i]);
+
+                Glib::Threads::Mutex::Lock lock(mutex);
+                done.push_back(i);
+
+                if (++checked == unknown.size())
+                    cond.signal();
+            });
+        }
+
+        Glib::Threads::Mutex::Lock lock(mutex);
+        while (checked < unknown.size())
+        {
+            // Found files and the progress are passed on every 100ms,
+            // the workers only wake this up early once every file is checked
+            const gint64 end = g_get_monotonic_time() + 100 * G_TIME_SPAN_MILLISECOND;
+            while (checked < unknown.size())
+                if (!cond.wait_until(mutex, end))
+                    break;
+
+            std::vector<std::string> batch;
+            for (const size_t i : done)
+                if (valid[i])
+                    batch.push_back(std::move(unknown[i]));
+            done.clear();
+
+            size_t n = checked;
+            lock.release();
+            found(std::move(batch), n, unknown.size());
+            lock.acquire();
+        }
+    }
 }
 
-void ImageList::on_thumbnail_loaded()
+void ImageList::scan_directory(const std::string &path)
 {
-    m_ThumbnailLoadedConn.block();
+    auto push = [ this ](std::vector<std::string> &&found)
+    {
+        // Only the first batch pushed to an empty queue wakes up the main thread.
+        // Empty batches aren't queued, they still wake it up to show the progress.
+        if ((found.empty() || m_ScanQueue.push(std::move(found))) && !m_ScanCancel->is_cancelled())
+            m_SignalEntriesScanned();
+    };
+
+    if (m_DirIndex->load())
+    {
+        push(m_DirIndex->get_paths());
+    }
+    else
+    {
+        std::vector<std::string> entries;
+
+        try
+        {
+            scan_entries<Image>(path, [ & ](std::vector<std::string> &&found, const size_t checked, const size_t total)
+            {
+                m_ScanChecked = checked;
+                m_ScanTotal = total;
+
+                entries.insert(entries.end(), found.begin(), found.end());
+                push(std::move(found));
+            }, m_ScanCancel);
+        }
+        catch (const Glib::FileError &ex)
+        {
+            std::cerr << ex.what() << std::endl;
+        }
+
+        if (!m_ScanCancel->is_cancelled() && !entries.empty())
+        {
+            NaturalSort::sort(entries);
+            m_DirIndex->save(entries);
+        }
+    }
+
+    if (!m_ScanCancel->is_cancelled())
+    {
+        m_ScanDone = true;
+        m_SignalScanFinished();
+    }
+}
+
+bool ImageList::next_thumbnail(size_t &index)
+{
+    Glib::Threads::Mutex::Lock lock(m_ThumbnailMutex);
+    const size_t size = m_ThumbnailTaken.size();
+
+    while (m_ThumbnailHi < size || m_ThumbnailLo > 0)
+    {
+        // Take whichever side is closer to the center, m_ThumbnailLo is one past the next index
+        bool down = m_ThumbnailHi < size &&
+            (m_ThumbnailLo == 0 || m_ThumbnailHi - m_ThumbnailCenter <= m_ThumbnailCenter - m_ThumbnailLo + 1);
+        size_t i = down ? m_ThumbnailHi++ : --m_ThumbnailLo;
+
+        if (!m_ThumbnailTaken[i])
+        {
+            m_ThumbnailTaken[i] = true;
+            index = i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ImageList::set_thumbnail_center(const size_t center)
+{
+    Glib::Threads::Mutex::Lock lock(m_ThumbnailMutex);
+    m_ThumbnailCenter = m_ThumbnailLo = m_ThumbnailHi =
+        std::min(center, m_ThumbnailTaken.empty() ? 0 : m_ThumbnailTaken.size() - 1);
+}
+
+void ImageList::get_thumbnail_window(size_t &start, size_t &end) const
+{
+    if (!m_Widget->get_visible_range(start, end))
+        start = end = m_Index;
+
+    const size_t margin = end - start + 1;
+    start = start > margin ? start - margin : 0;
+    end += margin;
+}
+
+void ImageList::add_thumbnail(const ThumbnailResult &result)
+{
+    const size_t index = result.index;
+    const Glib::RefPtr<Gdk::Pixbuf> &pixbuf = result.pixbuf;
+    Glib::RefPtr<Gdk::Pixbuf> &shown = m_ThumbnailShown[index];
+
+    if (m_ThumbnailResident.erase(index))
+        m_ThumbnailMemory -= shown->get_rowstride() * shown->get_height();
+
+    // The missing pixbuf is shared by every image
+    if (pixbuf && pixbuf != Image::get_missing_pixbuf())
+    {
+        m_ThumbnailResident.insert(index);
+        m_ThumbnailMemory += pixbuf->get_rowstride() * pixbuf->get_height();
+        m_ThumbnailImages[index] = result.image;
+    }
+    else
+    {
+        m_ThumbnailImages.erase(index);
+    }
+
+    shown = pixbuf;
+    m_ThumbnailEvicted.erase(index);
+    m_Widget->row_changed(index);
+}
+
+void ImageList::trim_thumbnails()
+{
+    const size_t limit = static_cast<size_t>(Settings.get_int("ThumbnailMemory")) * 1024 * 1024;
+
+    if (m_ThumbnailMemory <= limit)
+        return;
+
+    size_t start, end;
+    get_thumbnail_window(start, end);
+
+    auto distance = [ start, end ](const size_t i)
+    {
+        return i < start ? start - i : i > end ? i - end : 0;
+    };
+
+    while (m_ThumbnailMemory > limit && !m_ThumbnailResident.empty())
+    {
+        size_t first = *m_ThumbnailResident.begin(),
+               last  = *m_ThumbnailResident.rbegin(),
+               i     = distance(first) >= distance(last) ? first : last;
+
+        // Everything left is close to the visible rows
+        if (distance(i) == 0)
+            break;
+
+        Glib::RefPtr<Gdk::Pixbuf> &shown = m_ThumbnailShown[i];
+        m_ThumbnailMemory -= shown->get_rowstride() * shown->get_height();
+        shown = get_thumbnail_placeholder(shown->get_width(), shown->get_height());
+
+        // Images whose thumbnail is on disk load it from there again
+        auto it = m_ThumbnailImages.find(i);
+        if (it != m_ThumbnailImages.end() && !it->second->unload_thumbnail())
+            m_ThumbnailImages.erase(it);
+
+        m_ThumbnailEvicted.insert(i);
+        m_ThumbnailResident.erase(i);
+        m_Widget->row_changed(i);
+    }
+}
+
+void ImageList::requeue_thumbnails(const size_t start, const size_t end)
+{
+    auto first = m_ThumbnailEvicted.lower_bound(start),
+         last  = m_ThumbnailEvicted.upper_bound(end);
+
+    if (first == last)
+        return;
 
-    while (!m_ThumbnailQueue.empty() && !m_ThumbnailCancel->is_cancelled())
     {
         Glib::Threads::Mutex::Lock lock(m_ThumbnailMutex);
+        for (auto it = first; it != last; ++it)
+            m_ThumbnailTaken[*it] = false;
+    }
 
-        PixbufPair p = m_ThumbnailQueue.front();
-        m_Widget->set_pixbuf(p.first, p.second);
-        m_ThumbnailQueue.pop();
+    m_ThumbnailEvicted.erase(first, last);
+
+    // The workers may have already run out of thumbnails
+    if (m_ThumbnailThread)
+        m_ThumbnailRestart = true;
+    else
+        start_thumbnails(start + (end - start) / 2);
+}
+
+void ImageList::remap_thumbnails(const std::vector<size_t> &rows, const size_t size)
+{
+    // rows keeps the order, the remapped rows are added at the end of each container
+    std::map<size_t, Glib::RefPtr<Gdk::Pixbuf>> shown;
+    for (const auto &p : m_ThumbnailShown)
+    {
+        if (rows[p.first] != RemovedRow)
+            shown.emplace_hint(shown.end(), rows[p.first], p.second);
+        else if (m_ThumbnailResident.count(p.first))
+            m_ThumbnailMemory -= p.second->get_rowstride() * p.second->get_height();
+    }
+    m_ThumbnailShown.swap(shown);
+
+    std::map<size_t, std::shared_ptr<Image>> images;
+    for (auto &p : m_ThumbnailImages)
+        if (rows[p.first] != RemovedRow)
+            images.emplace_hint(images.end(), rows[p.first], std::move(p.second));
+    m_ThumbnailImages.swap(images);
+
+    for (std::set<size_t> *s : { &m_ThumbnailResident, &m_ThumbnailEvicted })
+    {
+        std::set<size_t> remapped;
+        for (const size_t i : *s)
+            if (rows[i] != RemovedRow)
+                remapped.insert(remapped.end(), rows[i]);
+        s->swap(remapped);
     }
 
-    m_ThumbnailLoadedConn.unblock();
+    // Added rows aren't taken, the next thumbnail workers load them
+    std::vector<bool> taken(size, false);
+
+    Glib::Threads::Mutex::Lock lock(m_ThumbnailMutex);
+    for (size_t i = 0; i < m_ThumbnailTaken.size() && i < rows.size(); ++i)
+        if (rows[i] != RemovedRow)
+            taken[rows[i]] = m_ThumbnailTaken[i];
+    m_ThumbnailTaken.swap(taken);
+}
+
+bool ImageList::stop_thumbnails()
+{
+    bool running = !!m_ThumbnailThread;
+
+    if (running)
+    {
+        m_ThumbnailCancel->cancel();
+        m_ThumbnailThread->join();
+        m_ThumbnailThread = nullptr;
+    }
+
+    // Their rows are about to change
+    m_ThumbnailQueue.pop_all(m_ThumbnailPending);
+    for (const ThumbnailResult &r : m_ThumbnailPending)
+        add_thumbnail(r);
+
+    m_ThumbnailPending.clear();
+    m_ThumbnailDrainConn.disconnect();
+
+    return running || m_ThumbnailRestart;
+}
+
+const Glib::RefPtr<Gdk::Pixbuf>& ImageList::get_thumbnail_placeholder(const int w, const int h)
+{
+    // Same size as the thumbnail it replaces so the rows don't move
+    Glib::RefPtr<Gdk::Pixbuf> &pixbuf = m_ThumbnailPlaceholders[std::make_pair(w, h)];
+
+    if (!pixbuf)
+    {
+        pixbuf = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, true, 8, w, h);
+        pixbuf->fill(0x00000000);
+    }
+
+    return pixbuf;
+}
+
+Glib::RefPtr<Gdk::Pixbuf> ImageList::get_row_thumbnail(const size_t index) const
+{
+    auto it = m_ThumbnailShown.find(index);
+    return it != m_ThumbnailShown.end() ? it->second : Glib::RefPtr<Gdk::Pixbuf>();
+}
+
+void ImageList::on_visible_range_changed()
+{
+    size_t start, end;
+
+    if (!m_Widget->get_visible_range(start, end))
+        return;
+
+    if (m_ThumbnailThread)
+        set_thumbnail_center(start + (end - start) / 2);
+
+    get_thumbnail_window(start, end);
+    requeue_thumbnails(start, end);
+    trim_thumbnails();
+}
+
+void ImageList::on_thumbnail_loaded()
+{
+    m_ThumbnailQueue.pop_all(m_ThumbnailPending);
+
+    if (!m_ThumbnailDrainConn.connected())
+        drain_thumbnails();
+}
+
+bool ImageList::drain_thumbnails()
+{
+    // ThumbnailBar::set_pixbuf can run the main loop,
+    // the outer call will add anything that arrives meanwhile
+    if (m_ThumbnailDraining)
+        return true;
+
+    m_ThumbnailDraining = true;
+    auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(ThumbnailDrainTime);
+
+    while (!m_ThumbnailPending.empty() && !m_ThumbnailCancel->is_cancelled())
+    {
+        add_thumbnail(m_ThumbnailPending.front());
+        m_ThumbnailPending.pop_front();
+
+        if (std::chrono::steady_clock::now() >= end)
+            break;
+    }
+
+    trim_thumbnails();
+    m_ThumbnailDraining = false;
+
+    // Let the widget redraw before adding the rest
+    bool more = !m_ThumbnailPending.empty() && !m_ThumbnailCancel->is_cancelled();
+    if (more && !m_ThumbnailDrainConn.connected())
+        m_ThumbnailDrainConn = Glib::signal_idle().connect(sigc::mem_fun(*this, &ImageList::drain_thumbnails));
+
+    return more;
 }
 
 void ImageList::on_thumbnails_loaded()
 {
     m_ThumbnailThread->join();
     m_ThumbnailThread = nullptr;
+
+    if (m_ThumbnailRestart)
+    {
+        size_t start, end;
+        get_thumbnail_window(start, end);
+
+        m_ThumbnailRestart = false;
+        start_thumbnails(start + (end - start) / 2);
+    }
+}
+
+void ImageList::on_entries_scanned()
+{
+    std::vector<std::vector<std::string>> batches;
+    m_ScanQueue.pop_all(batches);
+
+    if (m_ScanTotal > 0)
+        m_SignalScanProgress(m_ScanChecked, m_ScanTotal);
+
+    if (batches.empty())
+        return;
+
+    // The current image is already in the list
+    const std::string current = m_Current->get_path();
+    std::vector<std::string> entries;
+
+    for (std::vector<std::string> &b : batches)
+        for (std::string &e : b)
+            if (e != current)
+                entries.push_back(std::move(e));
+
+    if (entries.empty())
+        return;
+
+    std::vector<std::string> keys;
+    std::vector<size_t> rows;
+    bool currentRemoved;
+
+    NaturalSort::sort(entries, &keys);
+    update_widget_rows({ }, merge_images(entries, keys, { }, rows, currentRemoved));
+    m_Widget->update_selected(m_Index);
+
+    m_SignalSizeChanged();
+}
+
+void ImageList::on_scan_finished()
+{
+    // Emitted by the thread of an older load, a newer load already joined it
+    if (!m_ScanThread || !m_ScanDone)
+        return;
+
+    m_ScanThread->join();
+    m_ScanThread = nullptr;
+
+    // Batches emitted right before the thread finished
+    on_entries_scanned();
+
+    Glib::RefPtr<Gio::File> dir = Gio::File::create_for_path(Glib::path_get_dirname(get_current()->get_path()));
+    m_FileMonitor = dir->monitor_directory();
+    m_FileMonitor->signal_changed().connect(sigc::mem_fun(*this, &ImageList::on_directory_changed));
+
+    // The thumbnail workers index m_Images, they wait for it to stop changing
+    start_thumbnails(m_Index);
+    update_cache();
+
+    m_SignalSizeChanged();
 }
 
 void ImageList::on_directory_changed(const Glib::RefPtr<Gio::File> &file,
@@ -312,75 +865,221 @@ void ImageList::on_directory_changed(const Glib::RefPtr<Gio::File> &file,
 {
     if (!file) return;
 
-    ImageVector::iterator it;
-    auto comp = [ file ](const std::shared_ptr<Image> &i) { return i->get_path() == file->get_path(); };
+    const std::string path = file->get_path();
 
     if (event == Gio::FILE_MONITOR_EVENT_DELETED)
     {
-        if ((it = std::find_if(m_Images.begin(), m_Images.end(), comp)) != m_Images.end())
+        if (path == Glib::path_get_dirname(get_current()->get_path()))
         {
-            size_t index = it - m_Images.begin();
-            bool current = index == m_Index;
+            clear();
+            return;
+        }
+
+        m_MonitorEvents[path] = false;
+    }
+    // The changed event is used in case the created event was too quick,
+    // and the file was invalid while still being written
+    else if (event == Gio::FILE_MONITOR_EVENT_CREATED ||
+             event == Gio::FILE_MONITOR_EVENT_CHANGES_DONE_HINT)
+    {
+        m_MonitorEvents[path] = true;
+    }
+    else
+    {
+        return;
+    }
 
-            // Adjust m_Index if the deleted file was before it
-            if (index < m_Index)
-                --m_Index;
+    // Copying a lot of files into the directory doesn't update the list for every file
+    if (!m_MonitorConn.connected())
+        m_MonitorConn = Glib::signal_timeout().connect(
+                sigc::mem_fun(*this, &ImageList::apply_monitor_events), MonitorDelay);
+}
 
-            m_Widget->erase(index);
-            m_Images.erase(it);
+bool ImageList::apply_monitor_events()
+{
+    std::vector<size_t> removed;
+    std::vector<std::string> created;
 
-            if (current)
-            {
-                if (m_Images.empty())
-                {
-                    clear();
-                    return;
-                }
-                else
-                {
-                    set_current(index == 0 ? 0 : index - 1, false, true);
-                }
-            }
-            else
-            {
-                update_cache();
-            }
+    for (auto it = m_MonitorEvents.begin(); it != m_MonitorEvents.end();)
+    {
+        if (!it->second)
+        {
+            size_t index = m_Images.find(it->first);
 
-            m_SignalSizeChanged();
+            if (index < m_Images.size())
+                removed.push_back(index);
         }
-        else if (file->get_path() == Glib::path_get_dirname(get_current()->get_path()))
+        // Created files are left for the next time if the last ones are still being checked
+        else if (m_MonitorThread)
         {
-            clear();
+            ++it;
+            continue;
         }
+        else if (!m_Images.contains(it->first))
+        {
+            created.push_back(it->first);
+        }
+
+        it = m_MonitorEvents.erase(it);
     }
-    // The changed event is used in case the created event was too quick,
-    // and the file was invalid while still being written
-    else if ((event == Gio::FILE_MONITOR_EVENT_CREATED ||
-              event == Gio::FILE_MONITOR_EVENT_CHANGES_DONE_HINT) &&
-            Image::is_valid(file->get_path()))
+
+    if (!removed.empty())
     {
-        // Make sure the image wasn't already added
-        if (event == Gio::FILE_MONITOR_EVENT_CHANGES_DONE_HINT &&
-            std::find_if(m_Images.begin(), m_Images.end(), comp) != m_Images.end())
-            return;
+        std::vector<std::string> added;
+        std::sort(removed.begin(), removed.end());
+        apply_changes(added, removed);
+    }
 
-        std::shared_ptr<Image> img = std::make_shared<Image>(file->get_path());
-        it = std::lower_bound(m_Images.begin(), m_Images.end(), img, NaturalSort());
-        size_t index = it - m_Images.begin();
+    // Every image was deleted and the list was cleared
+    if (!created.empty() && !m_Images.empty())
+    {
+        m_MonitorChecking.swap(created);
+        m_MonitorValid.assign(m_MonitorChecking.size(), false);
+        m_MonitorThread = Glib::Threads::Thread::create(sigc::mem_fun(*this, &ImageList::check_files));
+    }
+
+    return false;
+}
+
+void ImageList::check_files()
+{
+    for (size_t i = 0; i < m_MonitorChecking.size() && !m_ScanCancel->is_cancelled(); ++i)
+        m_MonitorValid[i] = Image::is_valid(m_MonitorChecking[i]);
+
+    if (!m_ScanCancel->is_cancelled())
+        m_SignalFilesChecked();
+}
+
+void ImageList::on_files_checked()
+{
+    // The list was reset while the files were being checked
+    if (!m_MonitorThread)
+        return;
 
-        if (index <= m_Index)
-            ++m_Index;
+    m_MonitorThread->join();
+    m_MonitorThread = nullptr;
 
-        m_Widget->insert(index, img->get_thumbnail());
-        m_Images.insert(it, img);
+    std::vector<std::string> paths;
+
+    for (size_t i = 0; i < m_MonitorChecking.size(); ++i)
+    {
+        const std::string &p = m_MonitorChecking[i];
+        auto it = m_MonitorEvents.find(p);
+
+        // Skip files deleted meanwhile, they are removed with the next events.
+        // A file created again doesn't need to be checked again.
+        if (!m_MonitorValid[i] || m_Images.contains(p) ||
+            (it != m_MonitorEvents.end() && !it->second))
+            continue;
+
+        if (it != m_MonitorEvents.end())
+            m_MonitorEvents.erase(it);
+
+        paths.push_back(p);
+    }
+
+    m_MonitorChecking.clear();
+    m_MonitorValid.clear();
+
+    if (!paths.empty())
+        apply_changes(paths, { });
+
+    if (!m_MonitorEvents.empty() && !m_MonitorConn.connected())
+        m_MonitorConn = Glib::signal_timeout().connect(
+                sigc::mem_fun(*this, &ImageList::apply_monitor_events), MonitorDelay);
+}
+
+std::vector<size_t> ImageList::merge_images(const std::vector<std::string> &paths,
+                                            const std::vector<std::string> &keys,
+                                            const std::vector<size_t> &removed,
+                                            std::vector<size_t> &rows, bool &currentRemoved)
+{
+    const std::string current = m_Images.get_path(m_Index);
+    std::vector<size_t> inserted = m_Images.merge(paths, keys, removed, rows);
 
+    currentRemoved = rows[m_Index] == RemovedRow;
+
+    // The image before the current one becomes current
+    if (currentRemoved)
+    {
+        size_t index = m_Images.lower_bound(NaturalSort::make_key(current));
+        m_Index = index > 0 ? index - 1 : 0;
+    }
+    else
+    {
+        m_Index = rows[m_Index];
+    }
+
+    return inserted;
+}
+
+void ImageList::apply_changes(std::vector<std::string> &paths, const std::vector<size_t> &removed)
+{
+    // The workers index m_Images
+    bool restart = stop_thumbnails() || !paths.empty();
+    std::vector<std::string> keys;
+    std::vector<size_t> rows;
+    bool currentRemoved;
+
+    NaturalSort::sort(paths, &keys);
+    std::vector<size_t> inserted = merge_images(paths, keys, removed, rows, currentRemoved);
+
+    if (m_Images.empty())
+    {
+        clear();
+        return;
+    }
+
+    remap_thumbnails(rows, m_Images.size());
+    update_widget_rows(removed, inserted);
+
+    if (currentRemoved)
+    {
+        set_current(m_Index, false, true);
+    }
+    else
+    {
+        m_Widget->update_selected(m_Index);
         update_cache();
-        m_SignalSizeChanged();
+    }
+
+    // The thumbnails of the added images are loaded like the others
+    if (restart)
+    {
+        size_t start, end;
+        get_thumbnail_window(start, end);
+
+        m_ThumbnailRestart = false;
+        start_thumbnails(start + (end - start) / 2);
+    }
+
+    trim_thumbnails();
+    m_SignalSizeChanged();
+}
+
+void ImageList::update_widget_rows(const std::vector<size_t> &removed, const std::vector<size_t> &inserted)
+{
+    if (removed.size() + inserted.size() <= MaxRowChanges)
+    {
+        // Removing from the end first keeps the other removed rows where they were,
+        // the inserted rows are already at their final position
+        for (auto it = removed.rbegin(); it != removed.rend(); ++it)
+            m_Widget->erase(*it);
+        for (const size_t i : inserted)
+            m_Widget->insert(i);
+    }
+    else
+    {
+        // One model reset instead of a signal for every row
+        m_Widget->reset_model(m_Images.size());
     }
 }
 
 void ImageList::set_current_relative(const int d)
 {
+    if (is_scanning())
+        return;
+
     if ((d > 0 && m_Index + 1 < m_Images.size()) || (d < 0 && m_Index > 0))
     {
         set_current(m_Index + d);
@@ -399,53 +1098,103 @@ void ImageList::set_current_relative(const int d)
     }
 }
 
-void ImageList::update_cache()
+/**
+ * Learns the reading direction and speed from the index changes.
+ * Steps of one or two images in the same direction build up m_DirectionScore,
+ * a step in the other direction resets it and jumps are ignored.
+ **/
+void ImageList::update_navigation(const size_t index)
 {
-    std::vector<size_t> cache(m_Images.size()), diff;
-    std::iota(cache.begin(), cache.end(), 0);
-    std::sort(cache.begin(), cache.end(), m_IndexSort);
+    using namespace std::chrono;
+
+    steady_clock::time_point now = steady_clock::now();
+    double elapsed = duration_cast<duration<double>>(now - m_LastNavigation).count();
+    long d = static_cast<long>(index) - static_cast<long>(m_Index);
 
-    cache.resize(Settings.get_int("CacheSize") * 2 + 1);
+    m_LastNavigation = now;
 
-    // Get the indices of the images no longer in the cache
-    if (!m_Cache.empty())
+    if (d == 0 || std::abs(d) > 2)
     {
-        std::sort(m_Cache.begin(), m_Cache.end());
-        std::sort(cache.begin(), cache.end());
-        std::set_difference(m_Cache.begin(), m_Cache.end(),
-                cache.begin(), cache.end(), std::back_inserter(diff));
+        m_DirectionScore = 0;
+        m_Velocity = 0.0;
+        return;
     }
 
-    cancel_cache();
+    if ((d > 0) == (m_DirectionScore >= 0))
+        m_DirectionScore = d > 0 ? std::min(m_DirectionScore + 1, DirectionThreshold * 2) :
+                                   std::max(m_DirectionScore - 1, -DirectionThreshold * 2);
+    else
+        m_DirectionScore = d > 0 ? 1 : -1;
 
-    for (const size_t i : diff)
-        if (i < m_Images.size() - 1)
-            m_Images[i]->reset_pixbuf();
+    // Exponential moving average of the pages read per second
+    m_Velocity = m_Velocity / 2 + std::abs(d) / std::max(elapsed, 0.01) / 2;
+}
+
+/**
+ * Splits the cache window into the number of images to cache
+ * ahead of (in the reading direction) and behind the current image.
+ **/
+void ImageList::get_cache_window(size_t &ahead, size_t &behind) const
+{
+    size_t cacheSize = Settings.get_int("CacheSize");
 
-    // Start the cache loading thread
-    m_Cache = cache;
-    m_CacheThread = Glib::Threads::Thread::create([ this ]()
+    if (std::abs(m_DirectionScore) >= DirectionThreshold || m_Slideshow)
     {
-        for (const size_t i : m_Cache)
-        {
-            if (m_CacheCancel->is_cancelled())
-                break;
+        behind = std::min(cacheSize, static_cast<size_t>(1));
+        ahead  = cacheSize * 2 - behind;
 
-            m_Images[i]->load_pixbuf();
-        }
-    });
+        if (m_Slideshow || m_Velocity >= FastVelocity)
+            ahead += cacheSize;
+    }
+    else
+    {
+        ahead = behind = cacheSize;
+    }
 }
 
-void ImageList::cancel_cache()
+void ImageList::update_cache()
 {
-    if (m_CacheThread)
+    size_t ahead, behind;
+    get_cache_window(ahead, behind);
+
+    // When one side runs out of images the other side gets the remaining slots
+    bool backwards = m_DirectionScore <= -DirectionThreshold && !m_Slideshow;
+    size_t aheadAvail  = backwards ? m_Index : m_Images.size() - m_Index - 1,
+           behindAvail = backwards ? m_Images.size() - m_Index - 1 : m_Index;
+
+    if (ahead > aheadAvail)
+    {
+        behind += ahead - aheadAvail;
+        ahead = aheadAvail;
+    }
+    if (behind > behindAvail)
     {
-        m_CacheCancel->cancel();
+        ahead = std::min(ahead + behind - behindAvail, aheadAvail);
+        behind = behindAvail;
+    }
 
-        m_CacheThread->join();
-        m_CacheThread = nullptr;
-        m_CacheCancel->reset();
+    ImageVector cache;
+    cache.reserve(ahead + behind + 1);
+    cache.push_back(m_Current);
 
-        m_Cache.clear();
+    for (size_t i = 1; i <= std::max(ahead, behind); ++i)
+    {
+        if (i <= ahead)
+            cache.push_back(m_Images.get(backwards ? m_Index - i : m_Index + i));
+        if (i <= behind)
+            cache.push_back(m_Images.get(backwards ? m_Index + i : m_Index - i));
     }
+
+    m_Cache.set_budget(static_cast<size_t>(Settings.get_int("CacheMemory")) * 1024 * 1024);
+
+    // Only the images that are kept after trimming are decoded,
+    // the estimate in fit() can be lower than the real sizes
+    cache = m_Cache.trim(m_Cache.fit(cache));
+    m_Prefetcher.set_queue(cache);
+}
+
+void ImageList::cancel_cache()
+{
+    m_Prefetcher.cancel();
+    m_Cache.clear();
 }
@@ -1,15 +1,26 @@
 #ifndef _IMAGELIST_H_
 #define _IMAGELIST_H_
 
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
 #include <gtkmm.h>
+#include <map>
 #include <memory>
-#include <queue>
+#include <set>
 #include <string>
 #include <vector>
 
 #include "archive/archive.h"
 #include "booru/xml.h"
+#include "dirindex.h"
 #include "image.h"
+#include "imagecache.h"
+#include "imagecatalog.h"
+#include "mpscqueue.h"
+#include "prefetcher.h"
+#include "thumbnailmodel.h"
 
 namespace AhoViewer
 {
@@ -24,8 +35,22 @@ namespace AhoViewer
         // Emitted when AutoOpenArchive is true and loading an archive fails.
         using SignalArchiveErrorType = sigc::signal<void, const std::string>;
 
-        // Used for async thumbnail pixbuf loading
-        using PixbufPair = std::pair<size_t, const Glib::RefPtr<Gdk::Pixbuf>>;
+        // Emitted while files without a known extension are being checked, with
+        // the number of files checked so far and the number of files to check.
+        using SignalScanProgressType = sigc::signal<void, size_t, size_t>;
+
+        // Called with the valid files found while scanning a directory, the number
+        // of files checked so far and the number of files that need checking.
+        using ScanFunc = std::function<void(std::vector<std::string>&&, const size_t, const size_t)>;
+
+        // Used for async thumbnail pixbuf loading, the image is passed along
+        // so the main thread can keep it while its thumbnail is loaded
+        struct ThumbnailResult
+        {
+            size_t index;
+            std::shared_ptr<Image> image;
+            Glib::RefPtr<Gdk::Pixbuf> pixbuf;
+        };
     public:
         // ImageList::Widget {{{
         // This is used by ThumbnailBar and Booru::Page.
@@ -36,6 +61,7 @@ namespace AhoViewer
             // When the widget's selected item changes it will emit this signal.
             using SignalSelectedChangedType = sigc::signal<void, const size_t>;
         public:
+            Widget() : m_Model(ThumbnailModel::create()) { }
             virtual ~Widget() = default;
         protected:
             struct ModelColumns : public Gtk::TreeModelColumnRecord
@@ -45,39 +71,59 @@ namespace AhoViewer
             };
 
             virtual void set_selected(const size_t) = 0;
+            // Selects index after rows were added or removed,
+            // views that can be scrolled away from the selection only scroll back if they follow it
+            virtual void update_selected(const size_t index) { set_selected(index); }
             virtual void scroll_to_selected() = 0;
+            // Sets start and end to the first and last visible items,
+            // returns false if nothing is visible.
+            virtual bool get_visible_range(size_t &start, size_t &end) = 0;
+            // Sets the model of the view, model can be empty
+            virtual void set_model(const Glib::RefPtr<ThumbnailModel> &model) = 0;
 
             virtual void clear()
             {
-                m_ListStore->clear();
+                reset_model(0);
+            }
+            // The thumbnail of the row at index changed
+            virtual void row_changed(const size_t index)
+            {
+                m_Model->changed(index);
             }
-            virtual void set_pixbuf(const size_t index, const Glib::RefPtr<Gdk::Pixbuf> &pixbuf)
+            // Builds the path directly instead of parsing it from a string
+            static Gtk::TreePath get_path(const size_t index)
             {
-                Gtk::TreeIter it = m_ListStore->get_iter(std::to_string(index));
-                if (it) it->set_value(0, pixbuf);
+                Gtk::TreePath path;
+                path.push_back(index);
+                return path;
             }
             void reserve(const size_t s)
             {
-                for (size_t i = 0; i < s; ++i)
-                    m_ListStore->append();
+                // A few rows are added for each booru page,
+                // a whole directory is given to the view at once
+                if (m_Model->size() == 0)
+                    reset_model(s);
+                else
+                    m_Model->append(s);
             }
 
-            Glib::RefPtr<Gtk::ListStore> m_ListStore;
+            Glib::RefPtr<ThumbnailModel> m_Model;
             SignalSelectedChangedType m_SignalSelectedChanged;
+            // Emitted when the widget is scrolled
+            sigc::signal<void> m_SignalVisibleRangeChanged;
         private:
-            void erase(const size_t i)
+            // Giving the view the model again is cheaper than a signal for every row
+            void reset_model(const size_t size)
             {
-                Gtk::TreeIter it = m_ListStore->get_iter(std::to_string(i));
-                if (it) m_ListStore->erase(it);
-            }
-            void insert(const size_t i, const Glib::RefPtr<Gdk::Pixbuf> &pixbuf)
-            {
-                Gtk::TreeIter it = m_ListStore->get_iter(std::to_string(i));
-                it = it ? m_ListStore->insert(it) : m_ListStore->append();
-                it->set_value(0, pixbuf);
+                set_model(Glib::RefPtr<ThumbnailModel>());
+                m_Model->reset(size);
+                set_model(m_Model);
             }
+            void erase(const size_t i) { m_Model->erase(i); }
+            void insert(const size_t i) { m_Model->insert(i); }
 
             SignalSelectedChangedType signal_selected_changed() const { return m_SignalSelectedChanged; }
+            sigc::signal<void> signal_visible_range_changed() const { return m_SignalVisibleRangeChanged; }
         };
         // }}}
 
@@ -100,28 +146,45 @@ namespace AhoViewer
         virtual size_t get_size() const { return m_Images.size(); }
 
         size_t get_index() const { return m_Index; }
-        const std::shared_ptr<Image>& get_current() const { return m_Images[m_Index]; }
+        const std::shared_ptr<Image>& get_current() const { return m_Current; }
         const Archive& get_archive() const { return *m_Archive; }
         bool empty() const { return m_Images.empty(); }
         bool from_archive() const { return !!m_Archive; }
+        // The rest of the directory is still being added, navigation is disabled until it's sorted
+        bool is_scanning() const { return !!m_ScanThread; }
 
+        // Iterates the images of a booru list, local images are only created when needed
         ImageVector::iterator begin() { return m_Images.begin(); }
         ImageVector::iterator end() { return m_Images.end(); }
 
         void on_cache_size_changed();
+        void on_thumbnail_memory_changed() { trim_thumbnails(); }
+        // The cache window is extended ahead of the current image while the slideshow is running
+        void set_slideshow(const bool running);
+        // Cached images are scaled to their display size in the background using func
+        void set_scale_size_func(const Prefetcher::ScaleSizeFunc &func) { m_Prefetcher.set_scale_size_func(func); }
+        void set_decode_size_func(const Prefetcher::ScaleSizeFunc &func) { m_Prefetcher.set_decode_size_func(func); }
+        // Mipmaps are only worth their memory while the user is zooming
+        void set_build_mipmaps(const bool build) { m_Prefetcher.set_build_mipmaps(build); }
+        void on_scale_size_changed();
 
         SignalChangedType signal_changed() const { return m_SignalChanged; }
         SignalArchiveErrorType signal_archive_error() const { return m_SignalArchiveError; }
         sigc::signal<void> signal_cleared() const { return m_SignalCleared; }
         sigc::signal<void> signal_load_success() const { return m_SignalLoadSuccess; }
         sigc::signal<void> signal_size_changed() const { return m_SignalSizeChanged; }
+        SignalScanProgressType signal_scan_progress() const { return m_SignalScanProgress; }
     protected:
         virtual void set_current(const size_t index, const bool fromWidget = false, const bool force = false);
+        // Starts loading the thumbnails that haven't been loaded yet, the ones closest to center first.
+        void start_thumbnails(const size_t center);
         virtual void load_thumbnails();
 
         Widget *const m_Widget;
-        ImageVector m_Images;
+        ImageCatalog m_Images;
         size_t m_Index;
+        // Holds the image at m_Index, the catalog only keeps booru images
+        std::shared_ptr<Image> m_Current;
 
         Glib::RefPtr<Gio::Cancellable> m_ThumbnailCancel;
         Glib::Threads::Thread *m_ThumbnailThread;
@@ -131,34 +194,152 @@ namespace AhoViewer
         void reset();
         template <typename T>
         std::vector<std::string> get_entries(const std::string &path);
+        template <typename T>
+        void scan_entries(const std::string &path, const ScanFunc &found,
+                          const Glib::RefPtr<Gio::Cancellable> &cancellable = Glib::RefPtr<Gio::Cancellable>());
+
+        // Runs in m_ScanThread, adds the images in path to m_ScanQueue as they are found
+        void scan_directory(const std::string &path);
+        // Merges the scanned images into m_Images in order
+        void on_entries_scanned();
+        void on_scan_finished();
+
+        // Returns false when every thumbnail has been taken
+        bool next_thumbnail(size_t &index);
+        void set_thumbnail_center(const size_t center);
+
+        // Sets start and end to the rows whose thumbnails are kept loaded,
+        // the visible rows and a page above and below them.
+        void get_thumbnail_window(size_t &start, size_t &end) const;
+        void add_thumbnail(const ThumbnailResult &result);
+        // Replaces the thumbnails farthest from the visible rows with placeholders
+        // until they fit in the ThumbnailMemory setting
+        void trim_thumbnails();
+        // Loads the unloaded thumbnails of the rows between start and end again
+        void requeue_thumbnails(const size_t start, const size_t end);
+        // Moves the thumbnail bookkeeping of row i to rows[i], or drops it if rows[i] is RemovedRow
+        void remap_thumbnails(const std::vector<size_t> &rows, const size_t size);
+        // Stops the thumbnail workers and adds the thumbnails they already loaded,
+        // returns true if they were running or about to be restarted
+        bool stop_thumbnails();
+        const Glib::RefPtr<Gdk::Pixbuf>& get_thumbnail_placeholder(const int w, const int h);
+        // Used by the model of m_Widget
+        Glib::RefPtr<Gdk::Pixbuf> get_row_thumbnail(const size_t index) const;
 
         void on_thumbnail_loaded();
+        // Adds pending thumbnails to m_Widget for up to ThumbnailDrainTime,
+        // returns true if some are left for the next main loop iteration.
+        bool drain_thumbnails();
         void on_thumbnails_loaded();
+        void on_visible_range_changed();
         void on_directory_changed(const Glib::RefPtr<Gio::File> &file,
                                   const Glib::RefPtr<Gio::File>&,
                                   Gio::FileMonitorEvent event);
+        // Applies the monitor events collected during the last MonitorDelay
+        bool apply_monitor_events();
+        // Runs in m_MonitorThread, checks which of the created files are images
+        void check_files();
+        void on_files_checked();
+
+        // Removes the rows in removed (ascending) and merges the sorted paths into m_Images,
+        // keeping m_Index on the current image. Sets rows to the new row of each old row,
+        // and returns the rows of the added paths.
+        std::vector<size_t> merge_images(const std::vector<std::string> &paths, const std::vector<std::string> &keys,
+                                         const std::vector<size_t> &removed, std::vector<size_t> &rows,
+                                         bool &currentRemoved);
+        // Merges and removes images, then updates m_Widget, the thumbnails and the cache once.
+        // Sorts paths.
+        void apply_changes(std::vector<std::string> &paths, const std::vector<size_t> &removed);
+        void update_widget_rows(const std::vector<size_t> &removed, const std::vector<size_t> &inserted);
 
         void set_current_relative(const int d);
+        void update_navigation(const size_t index);
+        void get_cache_window(size_t &ahead, size_t &behind) const;
         void update_cache();
         void cancel_cache();
 
-        std::vector<size_t> m_Cache;
+        ImageCache m_Cache;
         std::unique_ptr<Archive> m_Archive;
         std::vector<std::string> m_ArchiveEntries;
-        std::queue<PixbufPair> m_ThumbnailQueue;
-        std::function<int(size_t, size_t)> m_IndexSort;
 
-        Glib::RefPtr<Gio::Cancellable> m_CacheCancel;
+        // When a single image is opened it's shown before the rest of its directory is scanned
+        Glib::Threads::Thread *m_ScanThread;
+        Glib::RefPtr<Gio::Cancellable> m_ScanCancel;
+        MPSCQueue<std::vector<std::string>> m_ScanQueue;
+        std::atomic<size_t> m_ScanChecked, m_ScanTotal;
+        // Set by m_ScanThread right before it emits m_SignalScanFinished
+        std::atomic<bool> m_ScanDone;
+        // Monitor events are collected for MonitorDelay and applied together,
+        // by path so created and changes done events of a file are only handled once.
+        // True for created files and false for deleted files.
+        std::map<std::string, bool> m_MonitorEvents;
+        sigc::connection m_MonitorConn;
+        // Created files are opened to check them in m_MonitorThread
+        Glib::Threads::Thread *m_MonitorThread;
+        std::vector<std::string> m_MonitorChecking;
+        std::vector<char> m_MonitorValid;
+
+        // Index of the directory m_ScanThread scans, read or written by the thread
+        std::unique_ptr<DirIndex> m_DirIndex;
+
+        // Filled by the thumbnail workers, the main thread moves them to m_ThumbnailPending
+        // and adds them to m_Widget a few at a time
+        MPSCQueue<ThumbnailResult> m_ThumbnailQueue;
+        std::deque<ThumbnailResult> m_ThumbnailPending;
+        sigc::connection m_ThumbnailDrainConn;
+        bool m_ThumbnailDraining;
+
+        // Thumbnails are loaded outwards from m_ThumbnailCenter, alternating between
+        // m_ThumbnailHi going down the list and m_ThumbnailLo going up.
+        // The center follows the visible rows of m_Widget, so the visible thumbnails are
+        // loaded first, then the ones closest to them.
+        std::vector<bool> m_ThumbnailTaken;
+        size_t m_ThumbnailCenter, m_ThumbnailLo, m_ThumbnailHi;
+
+        // What each row of m_Widget shows, the rows whose thumbnail counts towards
+        // m_ThumbnailMemory, and the rows showing a placeholder because their thumbnail
+        // was unloaded. Only used from the main thread.
+        std::map<size_t, Glib::RefPtr<Gdk::Pixbuf>> m_ThumbnailShown;
+        std::set<size_t> m_ThumbnailResident, m_ThumbnailEvicted;
+        // The images of the resident rows, and of the evicted rows whose thumbnail was
+        // compressed in memory. m_Images doesn't keep images alive, without these
+        // the copy would be freed and the image decoded again when it's scrolled back to.
+        std::map<size_t, std::shared_ptr<Image>> m_ThumbnailImages;
+        std::map<std::pair<int, int>, Glib::RefPtr<Gdk::Pixbuf>> m_ThumbnailPlaceholders;
+        size_t m_ThumbnailMemory;
+        // Set when thumbnails are requeued while the thumbnail thread is finishing
+        bool m_ThumbnailRestart;
+
+        // Used to predict which images will be viewed next
+        int m_DirectionScore;
+        double m_Velocity;
+        bool m_Slideshow;
+        std::chrono::steady_clock::time_point m_LastNavigation;
+
+        // Steps needed in the same direction before the cache window is skewed
+        static const int DirectionThreshold = 2;
+        // Pages per second after which the cache window is extended ahead
+        static constexpr double FastVelocity = 1.0;
+        // Milliseconds per main loop iteration spent adding thumbnails to m_Widget
+        static const int ThumbnailDrainTime = 8;
+        // Milliseconds monitor events are collected for before they are applied
+        static const int MonitorDelay = 100;
+        // More rows than this changing at once gives m_Widget the model again
+        static const size_t MaxRowChanges = 32;
+        static const size_t RemovedRow = ImageCatalog::RemovedRow;
+
+        Prefetcher m_Prefetcher;
         Glib::Threads::Mutex m_ThumbnailMutex;
-        Glib::Threads::Thread *m_CacheThread;
         Glib::RefPtr<Gio::FileMonitor> m_FileMonitor;
 
         Glib::Dispatcher m_SignalThumbnailLoaded,
-                         m_SignalThumbnailsLoaded;
-
-        sigc::connection m_ThumbnailLoadedConn;
+                         m_SignalThumbnailsLoaded,
+                         m_SignalEntriesScanned,
+                         m_SignalScanFinished,
+                         m_SignalFilesChecked;
 
         SignalArchiveErrorType      m_SignalArchiveError;
+        SignalScanProgressType      m_SignalScanProgress;
         sigc::signal<void>          m_SignalCleared,
                                     m_SignalLoadSuccess,
                                     m_SignalSizeChanged;
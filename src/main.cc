@@ -5,6 +5,7 @@
 #include <libxml/parser.h>
 
 #include "config.h"
+#include "formats.h"
 #include "mainwindow.h"
 
 #ifdef HAVE_GSTREAMER
@@ -24,6 +25,8 @@ int main(int argc, char **argv)
 #ifdef HAVE_GSTREAMER
     gst_init(&argc, &argv);
 #endif // HAVE_GSTREAMER
+    // Build the format registry before any thread uses it
+    AhoViewer::Formats::get_instance();
     Glib::RefPtr<Gtk::Builder> builder = Gtk::Builder::create();
 
     try
@@ -59,6 +59,14 @@ MainWindow::MainWindow(BaseObjectType *cobj, const Glib::RefPtr<Gtk::Builder> &b
     m_LocalImageList = std::make_shared<ImageList>(m_ThumbnailBar);
     m_LocalImageList->signal_archive_error().connect([ this ](const std::string e) { m_StatusBar->set_message(e); });
     m_LocalImageList->signal_load_success().connect([ this ]() { set_active_imagelist(m_LocalImageList); });
+    m_LocalImageList->signal_scan_progress().connect([ this ](size_t checked, size_t total)
+    {
+        m_StatusBar->set_progress(static_cast<double>(checked) / total);
+
+        // Archives and directories are scanned before the main loop runs again
+        if (get_window())
+            get_window()->process_updates(true);
+    });
     m_LocalImageList->signal_size_changed().connect([ this ]()
     {
         if (m_LocalImageList == m_ActiveImageList)
@@ -79,6 +87,14 @@ MainWindow::MainWindow(BaseObjectType *cobj, const Glib::RefPtr<Gtk::Builder> &b
             sigc::mem_fun(*this, &MainWindow::update_title));
     m_ImageBox->signal_slideshow_ended().connect(
             sigc::mem_fun(*this, &MainWindow::on_toggle_slideshow));
+    m_ImageBox->signal_scale_changed().connect([ this ]()
+    {
+        if (m_ActiveImageList)
+        {
+            m_ActiveImageList->set_build_mipmaps(m_ImageBox->get_zoom_mode() == ImageBox::ZoomMode::MANUAL);
+            m_ActiveImageList->on_scale_size_changed();
+        }
+    });
 
     m_PreferencesDialog->signal_bg_color_set().connect(
             sigc::mem_fun(m_ImageBox, &ImageBox::update_background_color));
@@ -88,6 +104,10 @@ MainWindow::MainWindow(BaseObjectType *cobj, const Glib::RefPtr<Gtk::Builder> &b
             sigc::mem_fun(m_ImageBox, &ImageBox::cursor_timeout));
     m_PreferencesDialog->signal_cache_size_changed().connect(
             sigc::mem_fun(*this, &MainWindow::on_cache_size_changed));
+    m_PreferencesDialog->signal_cache_memory_changed().connect(
+            sigc::mem_fun(*this, &MainWindow::on_cache_size_changed));
+    m_PreferencesDialog->signal_thumbnail_memory_changed().connect(
+            sigc::mem_fun(*this, &MainWindow::on_thumbnail_memory_changed));
     m_PreferencesDialog->signal_slideshow_delay_changed().connect(
             sigc::mem_fun(m_ImageBox, &ImageBox::reset_slideshow));
     m_PreferencesDialog->get_site_editor()->signal_edited().connect(
@@ -334,7 +354,23 @@ void MainWindow::set_active_imagelist(const std::shared_ptr<ImageList> &imageLis
 {
     m_ImageListConn.disconnect();
     m_ImageListClearedConn.disconnect();
+
+    // The slideshow only runs for the active list
+    if (m_ActiveImageList)
+        m_ActiveImageList->set_slideshow(false);
+
     m_ActiveImageList = imageList;
+    m_ActiveImageList->set_scale_size_func(
+            [ this ](const int origWidth, const int origHeight, int &w, int &h)
+            {
+                return m_ImageBox->get_scaled_size(origWidth, origHeight, w, h);
+            });
+    m_ActiveImageList->set_decode_size_func(
+            [ this ](const int origWidth, const int origHeight, int &w, int &h)
+            {
+                return m_ImageBox->get_decode_size(origWidth, origHeight, w, h);
+            });
+    m_ActiveImageList->set_build_mipmaps(m_ImageBox->get_zoom_mode() == ImageBox::ZoomMode::MANUAL);
 
     m_ImageListConn = m_ActiveImageList->signal_changed().connect(
             sigc::mem_fun(*this, &MainWindow::on_imagelist_changed));
@@ -352,6 +388,9 @@ void MainWindow::set_active_imagelist(const std::shared_ptr<ImageList> &imageLis
     {
         on_imagelist_cleared();
     }
+
+    // Clearing the image box stops the slideshow
+    m_ActiveImageList->set_slideshow(m_ImageBox->is_slideshow_running());
 }
 
 void MainWindow::save_window_geometry()
@@ -646,7 +685,7 @@ void MainWindow::set_sensitives()
 
     for (const std::string &s : names)
     {
-        bool sens = m_ActiveImageList && !m_ActiveImageList->empty();
+        bool sens = m_ActiveImageList && !m_ActiveImageList->empty() && !m_ActiveImageList->is_scanning();
 
         if (s == "NextImage")
             sens = sens && m_ActiveImageList->can_go_next();
@@ -763,6 +802,7 @@ void MainWindow::on_imagelist_cleared()
     }
 
     m_ImageBox->clear_image();
+    m_ActiveImageList->set_slideshow(false);
     m_StatusBar->clear_page_info();
     m_StatusBar->clear_filename();
 
@@ -777,6 +817,13 @@ void MainWindow::on_cache_size_changed()
         p->get_imagelist()->on_cache_size_changed();
 }
 
+void MainWindow::on_thumbnail_memory_changed()
+{
+    m_LocalImageList->on_thumbnail_memory_changed();
+    for (const Booru::Page *p : m_BooruBrowser->get_pages())
+        p->get_imagelist()->on_thumbnail_memory_changed();
+}
+
 void MainWindow::on_accel_edited(const std::string &accelPath, const std::string &actionName)
 {
     Glib::RefPtr<Gtk::Action> action = m_ActionGroup->get_action(actionName);
@@ -1064,6 +1111,7 @@ void MainWindow::on_last_image()
 void MainWindow::on_toggle_slideshow()
 {
     m_ImageBox->toggle_slideshow();
+    m_ActiveImageList->set_slideshow(m_ImageBox->is_slideshow_running());
     // update_title();
 }
 
@@ -0,0 +1,84 @@
+#ifndef _MPSCQUEUE_H_
+#define _MPSCQUEUE_H_
+
+#include <atomic>
+#include <utility>
+
+namespace AhoViewer
+{
+    // Lock-free queue with any number of producers and a single consumer.
+    // Producers push onto an atomic list, the consumer takes the whole list at once
+    // and gets the items back in the order they were pushed.
+    template<typename T>
+    class MPSCQueue
+    {
+    public:
+        MPSCQueue() : m_Head(nullptr) { }
+        ~MPSCQueue() { clear(); }
+
+        MPSCQueue(const MPSCQueue&) = delete;
+        MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+        // Returns true if the queue was empty, only then does the consumer need to be woken up.
+        bool push(T item)
+        {
+            Node *node = new Node(std::move(item), m_Head.load(std::memory_order_relaxed));
+
+            while (!m_Head.compare_exchange_weak(node->next, node,
+                                                 std::memory_order_release,
+                                                 std::memory_order_relaxed));
+
+            return !node->next;
+        }
+
+        // Appends every queued item to c in push order, consumer only.
+        template<typename Container>
+        void pop_all(Container &c)
+        {
+            Node *node = m_Head.exchange(nullptr, std::memory_order_acquire),
+                 *prev = nullptr;
+
+            // The list is newest first
+            while (node)
+            {
+                Node *next = node->next;
+                node->next = prev;
+                prev = node;
+                node = next;
+            }
+
+            while (prev)
+            {
+                Node *next = prev->next;
+                c.push_back(std::move(prev->item));
+                delete prev;
+                prev = next;
+            }
+        }
+
+        // Consumer only
+        void clear()
+        {
+            Node *node = m_Head.exchange(nullptr, std::memory_order_acquire);
+
+            while (node)
+            {
+                Node *next = node->next;
+                delete node;
+                node = next;
+            }
+        }
+    private:
+        struct Node
+        {
+            Node(T &&i, Node *n) : item(std::move(i)), next(n) { }
+
+            T item;
+            Node *next;
+        };
+
+        std::atomic<Node*> m_Head;
+    };
+}
+
+#endif /* _MPSCQUEUE_H_ */
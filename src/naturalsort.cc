@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <glibmm.h>
+
+#include "naturalsort.h"
+using namespace AhoViewer;
+
+namespace
+{
+    using KeyPair = std::pair<std::string, std::string>;
+
+    // Runs func(0) ... func(n - 1) on a thread pool and waits for them
+    template<typename T>
+    void parallel_for(const size_t n, const T &func)
+    {
+        if (n == 1)
+        {
+            func(0);
+            return;
+        }
+
+        Glib::ThreadPool pool(n);
+
+        for (size_t i = 0; i < n; ++i)
+            pool.push([ &func, i ]() { func(i); });
+
+        pool.shutdown();
+    }
+}
+
+std::string NaturalSort::make_key(const std::string &s)
+{
+    std::string key;
+    key.reserve(s.size() + 8);
+
+    for (size_t i = 0; i < s.size();)
+    {
+        if (g_ascii_isdigit(s[i]))
+        {
+            size_t start = i;
+
+            while (i < s.size() && g_ascii_isdigit(s[i]))
+                ++i;
+
+            // Leading zeros don't change the value, "01" and "1" are equal
+            while (start < i && s[start] == '0')
+                ++start;
+
+            // The length has to fit in a byte, a longer number is cut short
+            size_t length = std::min(i - start, static_cast<size_t>(0xFE));
+
+            key += '\x00';
+            key += static_cast<char>(length);
+            key.append(s, start, length);
+        }
+        else
+        {
+            key += g_ascii_tolower(s[i++]);
+        }
+    }
+
+    key += '\xFF';
+
+    return key;
+}
+
+void NaturalSort::sort(std::vector<std::string> &strings, std::vector<std::string> *keys)
+{
+    const size_t size = strings.size(),
+                 n    = size < ParallelThreshold ? 1 : std::max(static_cast<int>(g_get_num_processors()), 1);
+    std::vector<KeyPair> pairs(size);
+
+    // Each thread builds and sorts the keys of a chunk
+    std::vector<size_t> bounds(n + 1);
+    for (size_t i = 0; i <= n; ++i)
+        bounds[i] = size * i / n;
+
+    parallel_for(n, [ & ](const size_t c)
+    {
+        for (size_t i = bounds[c]; i < bounds[c + 1]; ++i)
+            pairs[i] = KeyPair(make_key(strings[i]), std::move(strings[i]));
+
+        std::sort(pairs.begin() + bounds[c], pairs.begin() + bounds[c + 1],
+                  [](const KeyPair &a, const KeyPair &b) { return a.first < b.first; });
+    });
+
+    // Then neighbouring chunks are merged until one is left
+    for (size_t width = 1; width < n; width *= 2)
+    {
+        parallel_for((n + width * 2 - 1) / (width * 2), [ & ](const size_t m)
+        {
+            size_t first  = m * width * 2,
+                   middle = std::min(first + width, n),
+                   last   = std::min(first + width * 2, n);
+
+            if (middle < last)
+                std::inplace_merge(pairs.begin() + bounds[first], pairs.begin() + bounds[middle],
+                                   pairs.begin() + bounds[last],
+                                   [](const KeyPair &a, const KeyPair &b) { return a.first < b.first; });
+        });
+    }
+
+    if (keys)
+    {
+        keys->clear();
+        keys->reserve(size);
+    }
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        strings[i] = std::move(pairs[i].second);
+
+        if (keys)
+            keys->push_back(std::move(pairs[i].first));
+    }
+}
@@ -1,63 +1,36 @@
 #ifndef _NATURALSORT_H_
 #define _NATURALSORT_H_
 
-#include <cctype>
-#include <cstdlib>
-
-#include "image.h"
+#include <string>
+#include <vector>
 
 namespace AhoViewer
 {
+    // Compares strings with the numbers in them compared by value, ie "2" < "10",
+    // and the letters compared case insensitively.
+    //
+    // Each string is turned into a key once, keys compare with memcmp (std::string's operator<)
+    // in the natural order of the strings, so comparisons don't parse the strings again.
     class NaturalSort
     {
     public:
-        bool operator()(const std::string &a, const std::string &b)
-        {
-            return compare_natural(a.c_str(), b.c_str());
-        }
-        bool operator()(const std::shared_ptr<Image> &a, const std::shared_ptr<Image> &b)
-        {
-            return compare_natural(a->get_path().c_str(), b->get_path().c_str());
-        }
-    private:
-        bool compare_natural(const char *a, const char *b)
-        {
-            // End of string
-            if (!a || !b) return !!a;
-
-            // Both are numbers, compare them as such
-            if (std::isdigit(*a) && std::isdigit(*b))
-            {
-                char *aAfter, *bAfter;
-                unsigned long aL = strtoul(a, &aAfter, 10),
-                              bL = strtoul(b, &bAfter, 10);
+        // A number becomes 0x00, the number of digits without leading zeros and the digits,
+        // 0x00 is lower than any character so numbers come before letters.
+        // Letters are lowercased and the key ends with 0xFF, when one string
+        // is the start of another the longer string comes first.
+        static std::string make_key(const std::string &s);
 
-                if (aL != bL) return aL < bL;
+        // Builds the keys once, and on every core when there are a lot of strings.
+        // If keys is given it's set to the keys of the sorted strings.
+        static void sort(std::vector<std::string> &strings, std::vector<std::string> *keys = nullptr);
 
-                return compare_natural(aAfter, bAfter);
-            }
-
-            // One of them is a number
-            if (std::isdigit(*a) || std::isdigit(*b))
-                return std::isdigit(*a);
-
-            // Both of them are not numbers
-            while (*a && *b)
-            {
-                // Both letters were the same, are they numbers?
-                if (std::isdigit(*a) || std::isdigit(*b))
-                    return compare_natural(a, b);
-
-                // Both are letters but different letters
-                if (std::tolower(*a) != std::tolower(*b))
-                    return std::tolower(*a) < std::tolower(*b);
-
-                ++a;
-                ++b;
-            }
-
-            return !!*a;
+        bool operator()(const std::string &a, const std::string &b) const
+        {
+            return make_key(a) < make_key(b);
         }
+    private:
+        // Smaller vectors are sorted on the calling thread
+        static const size_t ParallelThreshold = 16384;
     };
 }
 
@@ -0,0 +1,113 @@
+// Compares NaturalSort::sort with sorting by the strtoul comparator it replaced on synthetic file names.
+// Built with `make naturalsortbench`, optionally takes the number of names (1M by default).
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <glibmm.h>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+#include "naturalsort.h"
+using namespace AhoViewer;
+
+namespace
+{
+    // The comparator NaturalSort used before it had keys
+    bool compare_natural(const char *a, const char *b)
+    {
+        if (!a || !b) return !!a;
+
+        if (std::isdigit(*a) && std::isdigit(*b))
+        {
+            char *aAfter, *bAfter;
+            unsigned long aL = strtoul(a, &aAfter, 10),
+                          bL = strtoul(b, &bAfter, 10);
+
+            if (aL != bL) return aL < bL;
+
+            return compare_natural(aAfter, bAfter);
+        }
+
+        if (std::isdigit(*a) || std::isdigit(*b))
+            return std::isdigit(*a);
+
+        while (*a && *b)
+        {
+            if (std::isdigit(*a) || std::isdigit(*b))
+                return compare_natural(a, b);
+
+            if (std::tolower(*a) != std::tolower(*b))
+                return std::tolower(*a) < std::tolower(*b);
+
+            ++a;
+            ++b;
+        }
+
+        return !!*a;
+    }
+
+    template<typename T>
+    double time_ms(const T &func)
+    {
+        auto start = std::chrono::steady_clock::now();
+        func();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Glib::init();
+
+    const size_t n = argc > 1 ? std::max(std::atol(argv[1]), 1L) : 1000000;
+    const char *const prefixes[] = { "IMG_", "Scan ", "page", "DSC", "Screenshot from 2019-", "" };
+    const char *const extensions[] = { ".jpg", ".JPG", ".png", ".gif", ".webm" };
+
+    // Names like those of camera, scanner and manga directories, in a long common directory
+    std::mt19937 rng(1);
+    std::vector<std::string> names;
+    names.reserve(n);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        std::string name = "/home/user/Pictures/Some Collection/";
+        name += prefixes[rng() % G_N_ELEMENTS(prefixes)];
+
+        if (rng() % 2)
+            name += std::string(rng() % 4, '0');
+
+        name += std::to_string(rng() % (n * 4));
+
+        if (rng() % 3 == 0)
+            name += "_p" + std::to_string(rng() % 100);
+
+        name += extensions[rng() % G_N_ELEMENTS(extensions)];
+        names.push_back(std::move(name));
+    }
+
+    std::vector<std::string> a = names, b = names;
+
+    double reference = time_ms([&]()
+    {
+        std::sort(a.begin(), a.end(), [](const std::string &x, const std::string &y)
+                { return compare_natural(x.c_str(), y.c_str()); });
+    });
+    double keys = time_ms([&]() { NaturalSort::sort(b); });
+
+    // Names that compare equal can be in either order
+    size_t wrong = 0;
+    for (size_t i = 1; i < b.size(); ++i)
+        if (compare_natural(b[i].c_str(), b[i - 1].c_str()))
+            ++wrong;
+
+    std::cout << n << " names, " << g_get_num_processors() << " threads" << std::endl
+              << std::fixed << std::setprecision(1)
+              << "  strtoul comparator: " << std::setw(8) << reference << "ms" << std::endl
+              << "  NaturalSort::sort:  " << std::setw(8) << keys << "ms"
+              << "  (" << std::setprecision(2) << reference / keys << "x)" << std::endl
+              << "  out of order: " << wrong << std::endl;
+
+    return wrong == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -11,6 +11,8 @@ PreferencesDialog::PreferencesDialog(BaseObjectType *cobj, const Glib::RefPtr<Gt
     {
         { "CursorHideDelay",  sigc::signal<void>() },
         { "CacheSize",        sigc::signal<void>() },
+        { "CacheMemory",      sigc::signal<void>() },
+        { "ThumbnailMemory",  sigc::signal<void>() },
         { "SlideshowDelay",   sigc::signal<void>() },
     })
 {
@@ -60,6 +62,7 @@ PreferencesDialog::PreferencesDialog(BaseObjectType *cobj, const Glib::RefPtr<Gt
         "RememberLastFile",
         "StoreRecentFiles",
         "SaveThumbnails",
+        "TrustExtensions",
         "RememberLastSavePath",
     };
 
@@ -77,6 +80,8 @@ PreferencesDialog::PreferencesDialog(BaseObjectType *cobj, const Glib::RefPtr<Gt
     {
         "CursorHideDelay",
         "CacheSize",
+        "CacheMemory",
+        "ThumbnailMemory",
         "SlideshowDelay",
         "BooruLimit",
     };
@@ -20,6 +20,8 @@ namespace AhoViewer
         sigc::signal<void> signal_bg_color_set() const { return m_SignalBGColorSet; }
         sigc::signal<void> signal_cursor_hide_delay_changed() const { return m_SpinSignals.at("CursorHideDelay"); }
         sigc::signal<void> signal_cache_size_changed() const { return m_SpinSignals.at("CacheSize"); }
+        sigc::signal<void> signal_cache_memory_changed() const { return m_SpinSignals.at("CacheMemory"); }
+        sigc::signal<void> signal_thumbnail_memory_changed() const { return m_SpinSignals.at("ThumbnailMemory"); }
         sigc::signal<void> signal_slideshow_delay_changed() const { return m_SpinSignals.at("SlideshowDelay"); }
         sigc::signal<void> signal_title_format_changed() const { return m_SignalTitleFormatChanged; }
     private:
@@ -0,0 +1,177 @@
+#include <iostream>
+#include <set>
+
+#include "prefetcher.h"
+using namespace AhoViewer;
+
+Prefetcher::Prefetcher(ImageCache &cache)
+  : m_Cache(cache),
+    m_Quit(false),
+    m_BuildMipmaps(false)
+{
+
+}
+
+Prefetcher::~Prefetcher()
+{
+    {
+        Glib::Threads::Mutex::Lock lock(m_Mutex);
+        m_Queue = std::priority_queue<Job>();
+        m_Quit = true;
+        m_QueueCond.broadcast();
+    }
+
+    for (Glib::Threads::Thread *t : m_Threads)
+        t->join();
+}
+
+void Prefetcher::set_queue(const std::vector<std::shared_ptr<Image>> &images)
+{
+    Glib::Threads::Mutex::Lock lock(m_Mutex);
+
+    // Every booru tab has its own list, the workers are started once a list is viewed
+    if (m_Threads.empty() && !images.empty())
+    {
+        // Leave at least one core for the UI and the thumbnail threads
+        size_t n = std::max(std::min(static_cast<int>(g_get_num_processors()) - 1, 4), 2);
+
+        for (size_t i = 0; i < n; ++i)
+            m_Threads.push_back(Glib::Threads::Thread::create(sigc::mem_fun(*this, &Prefetcher::run)));
+    }
+
+    m_Queue = std::priority_queue<Job>();
+    m_Requeued.clear();
+
+    std::set<Image*> queued;
+
+    // Images that are already being decoded are not queued again
+    for (size_t i = 0; i < images.size(); ++i)
+    {
+        std::map<Image*, Glib::RefPtr<Gio::Cancellable>>::iterator it = m_Active.find(images[i].get());
+        queued.insert(images[i].get());
+
+        if (it == m_Active.end())
+            m_Queue.push(Job(i, images[i]));
+        else if (it->second->is_cancelled())
+            m_Requeued.insert(std::make_pair(images[i].get(), Job(i, images[i])));
+    }
+
+    // Free up the workers that are decoding images that fell out of the window
+    for (const std::pair<Image* const, Glib::RefPtr<Gio::Cancellable>> &job : m_Active)
+        if (queued.find(job.first) == queued.end())
+            job.second->cancel();
+
+    m_QueueCond.broadcast();
+}
+
+void Prefetcher::cancel()
+{
+    Glib::Threads::Mutex::Lock lock(m_Mutex);
+
+    m_Queue = std::priority_queue<Job>();
+    m_Requeued.clear();
+
+    for (const std::pair<Image* const, Glib::RefPtr<Gio::Cancellable>> &job : m_Active)
+        job.second->cancel();
+
+    while (!m_Active.empty())
+        m_IdleCond.wait(m_Mutex);
+}
+
+void Prefetcher::set_scale_size_func(const ScaleSizeFunc &func)
+{
+    Glib::Threads::Mutex::Lock lock(m_Mutex);
+    m_ScaleSizeFunc = func;
+}
+
+void Prefetcher::set_decode_size_func(const ScaleSizeFunc &func)
+{
+    Glib::Threads::Mutex::Lock lock(m_Mutex);
+    m_DecodeSizeFunc = func;
+}
+
+void Prefetcher::set_build_mipmaps(const bool build)
+{
+    Glib::Threads::Mutex::Lock lock(m_Mutex);
+    m_BuildMipmaps = build;
+}
+
+void Prefetcher::run()
+{
+    for (;;)
+    {
+        std::shared_ptr<Image> image;
+        ScaleSizeFunc scaleSize, decodeSize;
+        Glib::RefPtr<Gio::Cancellable> cancellable = Gio::Cancellable::create();
+        bool buildMipmaps;
+        {
+            Glib::Threads::Mutex::Lock lock(m_Mutex);
+
+            while (m_Queue.empty() && !m_Quit)
+                m_QueueCond.wait(m_Mutex);
+
+            if (m_Quit)
+                return;
+
+            image = m_Queue.top().image;
+            m_Queue.pop();
+            m_Active[image.get()] = cancellable;
+            scaleSize = m_ScaleSizeFunc;
+            decodeSize = m_DecodeSizeFunc;
+            buildMipmaps = m_BuildMipmaps;
+        }
+
+        try
+        {
+            image->load_pixbuf(decodeSize, cancellable);
+
+            if (!cancellable->is_cancelled())
+            {
+                // Done first so the display sized copy can be scaled from a mipmap
+                if (buildMipmaps)
+                    image->create_mipmaps();
+
+                if (scaleSize)
+                    scale(image, scaleSize);
+            }
+
+            // The decode may have finished before it was cancelled, a cancelled
+            // decode that was taken back has nothing to cache. Booru images
+            // are added while they download, their size is counted later.
+            if (image->get_pixbuf() || image->is_loading())
+                m_Cache.add(image);
+        }
+        catch (const Glib::Error &ex)
+        {
+            std::cerr << "Error while loading " << image->get_filename() << ": " << std::endl
+                      << "  " << ex.what() << std::endl;
+        }
+
+        Glib::Threads::Mutex::Lock lock(m_Mutex);
+        m_Active.erase(image.get());
+
+        std::map<Image*, Job>::iterator it = m_Requeued.find(image.get());
+        if (it != m_Requeued.end())
+        {
+            m_Queue.push(it->second);
+            m_Requeued.erase(it);
+            m_QueueCond.signal();
+        }
+
+        if (m_Active.empty())
+            m_IdleCond.broadcast();
+    }
+}
+
+void Prefetcher::scale(const std::shared_ptr<Image> &image, const ScaleSizeFunc &scaleSize)
+{
+    Glib::RefPtr<Gdk::PixbufAnimation> pixbuf = image->get_pixbuf();
+    int origWidth, origHeight, w, h;
+
+    // The pixbuf may have been decoded at a reduced size
+    image->get_full_size(origWidth, origHeight);
+
+    if (pixbuf && !image->is_loading() && pixbuf->is_static_image() &&
+        scaleSize(origWidth, origHeight, w, h))
+        image->create_scaled_pixbuf(w, h);
+}
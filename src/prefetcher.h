@@ -0,0 +1,71 @@
+#ifndef _PREFETCHER_H_
+#define _PREFETCHER_H_
+
+#include <giomm.h>
+#include <glibmm.h>
+#include <map>
+#include <memory>
+#include <queue>
+#include <vector>
+
+#include "imagecache.h"
+
+namespace AhoViewer
+{
+    // A long lived pool of worker threads that decode images for an ImageList,
+    // started the first time images are queued.
+    // Jobs are served in the order of their priority (distance from the current image),
+    // the queue can be replaced at any time without waiting for in-flight decodes.
+    // Decoded images are handed to the ImageCache which decides when to free them.
+    class Prefetcher
+    {
+    public:
+        using ScaleSizeFunc = Image::SizeFunc;
+
+        Prefetcher(ImageCache &cache);
+        ~Prefetcher();
+
+        // The images are expected to be sorted by priority, the first being the current image.
+        // In-flight decodes of images that are not in the new queue are cancelled.
+        void set_queue(const std::vector<std::shared_ptr<Image>> &images);
+
+        // Drops all queued jobs, cancels the in-flight decodes and waits for them to stop.
+        void cancel();
+
+        // When set, decoded images are also scaled to their display size
+        void set_scale_size_func(const ScaleSizeFunc &func);
+        // When set, images are decoded at a reduced size if they will be displayed smaller
+        void set_decode_size_func(const ScaleSizeFunc &func);
+        // When true, mipmaps are created for the decoded images
+        void set_build_mipmaps(const bool build);
+    private:
+        struct Job
+        {
+            Job(const size_t p, const std::shared_ptr<Image> &i) : priority(p), image(i) { }
+
+            // std::priority_queue pops the largest element first
+            bool operator<(const Job &rhs) const { return priority > rhs.priority; }
+
+            size_t priority;
+            std::shared_ptr<Image> image;
+        };
+
+        void run();
+        void scale(const std::shared_ptr<Image> &image, const ScaleSizeFunc &scaleSize);
+
+        ImageCache &m_Cache;
+        std::priority_queue<Job> m_Queue;
+        // In-flight jobs and their cancellables
+        std::map<Image*, Glib::RefPtr<Gio::Cancellable>> m_Active;
+        // Cancelled in-flight jobs that were queued again, they are pushed once they stop
+        std::map<Image*, Job> m_Requeued;
+        ScaleSizeFunc m_ScaleSizeFunc, m_DecodeSizeFunc;
+        std::vector<Glib::Threads::Thread*> m_Threads;
+
+        Glib::Threads::Mutex m_Mutex;
+        Glib::Threads::Cond m_QueueCond, m_IdleCond;
+        bool m_Quit, m_BuildMipmaps;
+    };
+}
+
+#endif /* _PREFETCHER_H_ */
@@ -0,0 +1,508 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "scaler.h"
+using namespace AhoViewer;
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCALER_X86 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    // Weights are fixed point numbers with this many fractional bits,
+    // small enough to be used as 16 bit pmaddwd operands
+    const int Precision = 14;
+    const int Round     = 1 << (Precision - 1);
+    // Number of output rows that share one horizontal pass buffer
+    const int BandRows  = 64;
+
+    struct Coeffs
+    {
+        // Maximum number of taps of a single output pixel
+        int taps;
+        // First source pixel and number of taps of each output pixel
+        std::vector<int> bounds;
+        // taps weights per output pixel
+        std::vector<int16_t> weights;
+    };
+
+    using HorizontalFunc = void (*)(const uint8_t *src, uint8_t *dst, const int channels,
+                                    const bool premultiply, const Coeffs &c);
+    using VerticalFunc   = void (*)(const uint8_t *const *rows, uint8_t *dst, const int bytes,
+                                    const int16_t *weights, const int count);
+
+    struct Kernels
+    {
+        const char *name;
+        HorizontalFunc horizontal;
+        VerticalFunc vertical;
+    };
+
+    double box(double x)
+    {
+        return x > -0.5 && x <= 0.5 ? 1.0 : 0.0;
+    }
+
+    double bicubic(double x)
+    {
+        const double a = -0.5;
+        x = std::fabs(x);
+
+        if (x < 1.0)
+            return ((a + 2.0) * x - (a + 3.0)) * x * x + 1.0;
+        else if (x < 2.0)
+            return (((x - 5.0) * x + 8.0) * x - 4.0) * a;
+
+        return 0.0;
+    }
+
+    double sinc(double x)
+    {
+        if (x == 0.0)
+            return 1.0;
+
+        // atan(1) * 4 = pi
+        x *= std::atan(1) * 4;
+        return std::sin(x) / x;
+    }
+
+    double lanczos(double x)
+    {
+        return x > -3.0 && x < 3.0 ? sinc(x) * sinc(x / 3.0) : 0.0;
+    }
+
+    Coeffs compute_coeffs(const int inSize, const int outSize, const Scaler::Filter filter)
+    {
+        double (*func)(double);
+        double support;
+
+        switch (filter)
+        {
+            case Scaler::Filter::BOX:
+                func = box;
+                support = 0.5;
+                break;
+            case Scaler::Filter::BICUBIC:
+                func = bicubic;
+                support = 2.0;
+                break;
+            default:
+                func = lanczos;
+                support = 3.0;
+                break;
+        }
+
+        // When downscaling the filter is stretched over the source pixels
+        // that make up one output pixel
+        double scale       = static_cast<double>(inSize) / outSize,
+               filterScale = std::max(scale, 1.0);
+        support *= filterScale;
+
+        Coeffs c;
+        c.taps = static_cast<int>(std::ceil(support)) * 2 + 1;
+        c.bounds.resize(outSize * 2);
+        c.weights.resize(static_cast<size_t>(outSize) * c.taps, 0);
+
+        std::vector<double> w(c.taps);
+
+        for (int i = 0; i < outSize; ++i)
+        {
+            double center = (i + 0.5) * scale,
+                   total  = 0.0;
+            int first = std::max(static_cast<int>(center - support + 0.5), 0),
+                count = std::min(static_cast<int>(center + support + 0.5), inSize) - first;
+
+            count = std::min(std::max(count, 1), c.taps);
+
+            for (int k = 0; k < count; ++k)
+            {
+                w[k] = func((k + first - center + 0.5) / filterScale);
+                total += w[k];
+            }
+
+            int16_t *weights = &c.weights[static_cast<size_t>(i) * c.taps];
+            for (int k = 0; k < count; ++k)
+                weights[k] = static_cast<int16_t>(std::lround(
+                            (total != 0.0 ? w[k] / total : 1.0 / count) * (1 << Precision)));
+
+            c.bounds[i * 2]     = first;
+            c.bounds[i * 2 + 1] = count;
+        }
+
+        return c;
+    }
+
+    inline uint8_t clamp(const int v)
+    {
+        return v < 0 ? 0 : v > 255 ? 255 : v;
+    }
+
+    inline int div255(const int v)
+    {
+        return (v + 128 + ((v + 128) >> 8)) >> 8;
+    }
+
+    void horizontal_scalar(const uint8_t *src, uint8_t *dst, const int channels,
+                           const bool premultiply, const Coeffs &c)
+    {
+        const int outSize = c.bounds.size() / 2;
+
+        for (int x = 0; x < outSize; ++x)
+        {
+            const int first = c.bounds[x * 2], count = c.bounds[x * 2 + 1];
+            const int16_t *w = &c.weights[static_cast<size_t>(x) * c.taps];
+            int acc[4] = { Round, Round, Round, Round };
+
+            for (int k = 0; k < count; ++k)
+            {
+                const uint8_t *p = src + (first + k) * channels;
+
+                for (int ch = 0; ch < channels; ++ch)
+                    acc[ch] += (premultiply && ch < 3 ? div255(p[ch] * p[3]) : p[ch]) * w[k];
+            }
+
+            for (int ch = 0; ch < channels; ++ch)
+                dst[x * channels + ch] = clamp(acc[ch] >> Precision);
+        }
+    }
+
+    void vertical_scalar_range(const uint8_t *const *rows, uint8_t *dst, const int from, const int to,
+                               const int16_t *weights, const int count)
+    {
+        for (int i = from; i < to; ++i)
+        {
+            int acc = Round;
+
+            for (int k = 0; k < count; ++k)
+                acc += rows[k][i] * weights[k];
+
+            dst[i] = clamp(acc >> Precision);
+        }
+    }
+
+    void vertical_scalar(const uint8_t *const *rows, uint8_t *dst, const int bytes,
+                         const int16_t *weights, const int count)
+    {
+        vertical_scalar_range(rows, dst, 0, bytes, weights, count);
+    }
+
+#ifdef SCALER_X86
+    // Two weights packed into each 32 bit lane for pmaddwd
+    inline int pair_weights(const int16_t a, const int16_t b)
+    {
+        return static_cast<int>((static_cast<uint32_t>(static_cast<uint16_t>(b)) << 16) |
+                                 static_cast<uint16_t>(a));
+    }
+
+    // Loads one pixel into the low four 16 bit lanes
+    __attribute__((target("sse2")))
+    inline __m128i load_pixel_sse2(const uint8_t *p, const int channels, const bool premultiply)
+    {
+        uint32_t v = 0;
+        std::memcpy(&v, p, channels);
+        __m128i px = _mm_unpacklo_epi8(_mm_cvtsi32_si128(v), _mm_setzero_si128());
+
+        if (premultiply)
+        {
+            // r, g, b, a * a, a, a, 255
+            __m128i a = _mm_insert_epi16(_mm_shufflelo_epi16(px, _MM_SHUFFLE(3, 3, 3, 3)), 255, 3);
+            px = _mm_add_epi16(_mm_mullo_epi16(px, a), _mm_set1_epi16(128));
+            px = _mm_srli_epi16(_mm_add_epi16(px, _mm_srli_epi16(px, 8)), 8);
+        }
+
+        return px;
+    }
+
+    __attribute__((target("sse2")))
+    inline void store_pixel_sse2(uint8_t *p, const int channels, __m128i acc)
+    {
+        acc = _mm_srai_epi32(acc, Precision);
+        acc = _mm_packus_epi16(_mm_packs_epi32(acc, acc), acc);
+
+        uint32_t v = _mm_cvtsi128_si32(acc);
+        std::memcpy(p, &v, channels);
+    }
+
+    // Accumulates the taps two at a time starting at k
+    __attribute__((target("sse2")))
+    inline __m128i horizontal_taps_sse2(const uint8_t *src, const int channels, const bool premultiply,
+                                        const int16_t *w, int k, const int count, __m128i acc)
+    {
+        for (; k + 1 < count; k += 2)
+        {
+            __m128i p = _mm_unpacklo_epi16(load_pixel_sse2(src + k * channels, channels, premultiply),
+                                           load_pixel_sse2(src + (k + 1) * channels, channels, premultiply));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(p, _mm_set1_epi32(pair_weights(w[k], w[k + 1]))));
+        }
+
+        if (k < count)
+        {
+            __m128i p = _mm_unpacklo_epi16(load_pixel_sse2(src + k * channels, channels, premultiply),
+                                           _mm_setzero_si128());
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(p, _mm_set1_epi32(pair_weights(w[k], 0))));
+        }
+
+        return acc;
+    }
+
+    __attribute__((target("sse2")))
+    void horizontal_sse2(const uint8_t *src, uint8_t *dst, const int channels,
+                         const bool premultiply, const Coeffs &c)
+    {
+        const int outSize = c.bounds.size() / 2;
+
+        for (int x = 0; x < outSize; ++x)
+        {
+            const int first = c.bounds[x * 2], count = c.bounds[x * 2 + 1];
+            const int16_t *w = &c.weights[static_cast<size_t>(x) * c.taps];
+
+            __m128i acc = horizontal_taps_sse2(src + first * channels, channels, premultiply,
+                                               w, 0, count, _mm_set1_epi32(Round));
+            store_pixel_sse2(dst + x * channels, channels, acc);
+        }
+    }
+
+    __attribute__((target("sse2")))
+    void vertical_sse2_range(const uint8_t *const *rows, uint8_t *dst, int i, const int bytes,
+                             const int16_t *weights, const int count)
+    {
+        const __m128i zero = _mm_setzero_si128();
+
+        for (; i + 8 <= bytes; i += 8)
+        {
+            __m128i lo = _mm_set1_epi32(Round),
+                    hi = lo;
+            int k = 0;
+
+            for (; k + 1 < count; k += 2)
+            {
+                __m128i a  = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(rows[k] + i)), zero),
+                        b  = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(rows[k + 1] + i)), zero),
+                        wv = _mm_set1_epi32(pair_weights(weights[k], weights[k + 1]));
+
+                lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), wv));
+                hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), wv));
+            }
+
+            if (k < count)
+            {
+                __m128i a  = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(rows[k] + i)), zero),
+                        wv = _mm_set1_epi32(pair_weights(weights[k], 0));
+
+                lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(a, zero), wv));
+                hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(a, zero), wv));
+            }
+
+            __m128i v = _mm_packs_epi32(_mm_srai_epi32(lo, Precision), _mm_srai_epi32(hi, Precision));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(v, v));
+        }
+
+        vertical_scalar_range(rows, dst, i, bytes, weights, count);
+    }
+
+    __attribute__((target("sse2")))
+    void vertical_sse2(const uint8_t *const *rows, uint8_t *dst, const int bytes,
+                       const int16_t *weights, const int count)
+    {
+        vertical_sse2_range(rows, dst, 0, bytes, weights, count);
+    }
+
+    __attribute__((target("avx2")))
+    void horizontal_avx2(const uint8_t *src, uint8_t *dst, const int channels,
+                         const bool premultiply, const Coeffs &c)
+    {
+        const int outSize = c.bounds.size() / 2;
+
+        for (int x = 0; x < outSize; ++x)
+        {
+            const int first = c.bounds[x * 2], count = c.bounds[x * 2 + 1];
+            const int16_t *w = &c.weights[static_cast<size_t>(x) * c.taps];
+            const uint8_t *p = src + first * channels;
+            __m256i acc = _mm256_setzero_si256();
+            int k = 0;
+
+            // Four taps at a time, two in each half
+            for (; k + 3 < count; k += 4)
+            {
+                __m128i lo = _mm_unpacklo_epi16(load_pixel_sse2(p + k * channels, channels, premultiply),
+                                                load_pixel_sse2(p + (k + 1) * channels, channels, premultiply)),
+                        hi = _mm_unpacklo_epi16(load_pixel_sse2(p + (k + 2) * channels, channels, premultiply),
+                                                load_pixel_sse2(p + (k + 3) * channels, channels, premultiply));
+                __m256i px = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1),
+                        wv = _mm256_inserti128_si256(
+                                _mm256_castsi128_si256(_mm_set1_epi32(pair_weights(w[k], w[k + 1]))),
+                                _mm_set1_epi32(pair_weights(w[k + 2], w[k + 3])), 1);
+
+                acc = _mm256_add_epi32(acc, _mm256_madd_epi16(px, wv));
+            }
+
+            __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+            sum = horizontal_taps_sse2(p, channels, premultiply, w, k, count,
+                                       _mm_add_epi32(sum, _mm_set1_epi32(Round)));
+            store_pixel_sse2(dst + x * channels, channels, sum);
+        }
+    }
+
+    __attribute__((target("avx2")))
+    void vertical_avx2(const uint8_t *const *rows, uint8_t *dst, const int bytes,
+                       const int16_t *weights, const int count)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        int i = 0;
+
+        for (; i + 16 <= bytes; i += 16)
+        {
+            __m256i lo = _mm256_set1_epi32(Round),
+                    hi = lo;
+            int k = 0;
+
+            // The unpacks work within 128 bit lanes, packing the results back up
+            // in the same way puts the bytes back in order
+            for (; k + 1 < count; k += 2)
+            {
+                __m256i a  = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k] + i))),
+                        b  = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k + 1] + i))),
+                        wv = _mm256_set1_epi32(pair_weights(weights[k], weights[k + 1]));
+
+                lo = _mm256_add_epi32(lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), wv));
+                hi = _mm256_add_epi32(hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), wv));
+            }
+
+            if (k < count)
+            {
+                __m256i a  = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k] + i))),
+                        wv = _mm256_set1_epi32(pair_weights(weights[k], 0));
+
+                lo = _mm256_add_epi32(lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, zero), wv));
+                hi = _mm256_add_epi32(hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, zero), wv));
+            }
+
+            __m256i v = _mm256_packs_epi32(_mm256_srai_epi32(lo, Precision), _mm256_srai_epi32(hi, Precision));
+            v = _mm256_permute4x64_epi64(_mm256_packus_epi16(v, v), _MM_SHUFFLE(3, 1, 2, 0));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm256_castsi256_si128(v));
+        }
+
+        vertical_sse2_range(rows, dst, i, bytes, weights, count);
+    }
+#endif // SCALER_X86
+
+    const Kernels& get_kernels()
+    {
+        static const Kernels kernels = []()
+        {
+#ifdef SCALER_X86
+            __builtin_cpu_init();
+
+            if (__builtin_cpu_supports("avx2"))
+                return Kernels { "AVX2", horizontal_avx2, vertical_avx2 };
+            else if (__builtin_cpu_supports("sse2"))
+                return Kernels { "SSE2", horizontal_sse2, vertical_sse2 };
+#endif // SCALER_X86
+            return Kernels { "scalar", horizontal_scalar, vertical_scalar };
+        }();
+
+        return kernels;
+    }
+
+    void unpremultiply(uint8_t *pixels, const int w, const int h, const int stride)
+    {
+        for (int y = 0; y < h; ++y)
+        {
+            for (uint8_t *p = pixels + y * stride, *end = p + w * 4; p < end; p += 4)
+            {
+                const int a = p[3];
+
+                if (a == 0)
+                {
+                    p[0] = p[1] = p[2] = 0;
+                }
+                else if (a != 255)
+                {
+                    for (int ch = 0; ch < 3; ++ch)
+                        p[ch] = std::min((p[ch] * 255 + a / 2) / a, 255);
+                }
+            }
+        }
+    }
+}
+
+Glib::RefPtr<Gdk::Pixbuf> Scaler::scale(const Glib::RefPtr<const Gdk::Pixbuf> &pixbuf,
+                                        const int w, const int h, Filter filter)
+{
+    const int srcWidth  = pixbuf->get_width(),
+              srcHeight = pixbuf->get_height(),
+              channels  = pixbuf->get_n_channels();
+    const bool alpha    = pixbuf->get_has_alpha();
+
+    // Nothing else is produced by gdk-pixbuf's loaders
+    if (pixbuf->get_bits_per_sample() != 8 || pixbuf->get_colorspace() != Gdk::COLORSPACE_RGB ||
+        channels != (alpha ? 4 : 3) || w <= 0 || h <= 0)
+        return pixbuf->scale_simple(w, h, Gdk::INTERP_BILINEAR);
+
+    if (filter == Filter::AUTO)
+    {
+        if (w * 2 <= srcWidth && h * 2 <= srcHeight)
+            filter = Filter::BOX;
+        else if (w <= srcWidth && h <= srcHeight)
+            filter = Filter::LANCZOS;
+        else
+            filter = Filter::BICUBIC;
+    }
+
+    const Kernels &kernels = get_kernels();
+    const Coeffs hCoeffs = compute_coeffs(srcWidth, w, filter),
+                 vCoeffs = compute_coeffs(srcHeight, h, filter);
+
+    Glib::RefPtr<Gdk::Pixbuf> scaled = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, alpha, 8, w, h);
+
+    const uint8_t *srcPixels = pixbuf->get_pixels();
+    uint8_t *dstPixels       = scaled->get_pixels();
+    const int srcStride      = pixbuf->get_rowstride(),
+              dstStride      = scaled->get_rowstride(),
+              tmpStride      = w * channels;
+
+    std::vector<uint8_t> tmp;
+    std::vector<const uint8_t*> rows(vCoeffs.taps);
+
+    // The horizontal pass is done in bands so that the intermediate buffer
+    // only has to hold the source rows of a few output rows
+    for (int y1 = 0; y1 < h; y1 += BandRows)
+    {
+        const int y2    = std::min(y1 + BandRows, h),
+                  first = vCoeffs.bounds[y1 * 2],
+                  last  = vCoeffs.bounds[(y2 - 1) * 2] + vCoeffs.bounds[(y2 - 1) * 2 + 1];
+
+        tmp.resize(static_cast<size_t>(last - first) * tmpStride);
+
+        for (int y = first; y < last; ++y)
+            kernels.horizontal(srcPixels + static_cast<size_t>(y) * srcStride,
+                               &tmp[static_cast<size_t>(y - first) * tmpStride],
+                               channels, alpha, hCoeffs);
+
+        for (int y = y1; y < y2; ++y)
+        {
+            const int start = vCoeffs.bounds[y * 2], count = vCoeffs.bounds[y * 2 + 1];
+
+            for (int k = 0; k < count; ++k)
+                rows[k] = &tmp[static_cast<size_t>(start - first + k) * tmpStride];
+
+            kernels.vertical(rows.data(), dstPixels + static_cast<size_t>(y) * dstStride, tmpStride,
+                             &vCoeffs.weights[static_cast<size_t>(y) * vCoeffs.taps], count);
+        }
+    }
+
+    if (alpha)
+        unpremultiply(dstPixels, w, h, dstStride);
+
+    return scaled;
+}
+
+const char* Scaler::get_simd_name()
+{
+    return get_kernels().name;
+}
@@ -0,0 +1,33 @@
+#ifndef _SCALER_H_
+#define _SCALER_H_
+
+#include <gdkmm.h>
+
+namespace AhoViewer
+{
+    // Separable image resampler, a faster and better looking replacement for
+    // Gdk::Pixbuf::scale_simple. Heavy downscales use an area (box) filter,
+    // everything else a Lanczos or bicubic filter.
+    // The kernels use AVX2 or SSE2 when the CPU supports them.
+    class Scaler
+    {
+    public:
+        enum class Filter
+        {
+            AUTO,
+            BOX,
+            BICUBIC,
+            LANCZOS,
+        };
+
+        // This is thread safe.
+        static Glib::RefPtr<Gdk::Pixbuf> scale(const Glib::RefPtr<const Gdk::Pixbuf> &pixbuf,
+                                               const int w, const int h,
+                                               Filter filter = Filter::AUTO);
+
+        // The name of the instruction set the kernels use, "AVX2", "SSE2" or "scalar".
+        static const char* get_simd_name();
+    };
+}
+
+#endif /* _SCALER_H_ */
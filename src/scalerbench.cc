@@ -0,0 +1,75 @@
+// Compares Scaler::scale with Gdk::Pixbuf::scale_simple on random RGB and RGBA images.
+// Built with `make scalerbench`, optionally takes the number of runs per case.
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <gdkmm/wrap_init.h>
+#include <iomanip>
+#include <iostream>
+
+#include "scaler.h"
+using namespace AhoViewer;
+
+namespace
+{
+    struct Case
+    {
+        int srcWidth, srcHeight,
+            dstWidth, dstHeight;
+    };
+
+    template<typename T>
+    double time_ms(const int runs, const T &func)
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        for (int i = 0; i < runs; ++i)
+            func();
+
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / runs;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Glib::init();
+    Gdk::wrap_init();
+
+    const int runs = argc > 1 ? std::max(std::atoi(argv[1]), 1) : 5;
+    const Case cases[] =
+    {
+        { 6000, 4000, 1920, 1280 }, // Camera photo fitted to the window
+        { 6000, 4000,  128,   85 }, // Thumbnail
+        { 2000, 3000, 1280, 1920 }, // Moderate downscale
+        { 1280,  720, 2560, 1440 }, // Manual zoom
+    };
+
+    std::cout << "Scaler kernels: " << Scaler::get_simd_name() << ", " << runs << " runs per case" << std::endl;
+
+    for (const bool alpha : { false, true })
+    {
+        for (const Case &c : cases)
+        {
+            Glib::RefPtr<Gdk::Pixbuf> src = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, alpha, 8, c.srcWidth, c.srcHeight);
+            guint8 *pixels = src->get_pixels();
+
+            // The last row is not padded to the rowstride
+            for (size_t i = 0, n = static_cast<size_t>(src->get_rowstride()) * (c.srcHeight - 1) +
+                                   c.srcWidth * src->get_n_channels(); i < n; ++i)
+                pixels[i] = std::rand();
+
+            double gdk = time_ms(runs, [&]() { src->scale_simple(c.dstWidth, c.dstHeight, Gdk::INTERP_BILINEAR); }),
+                   ours = time_ms(runs, [&]() { Scaler::scale(src, c.dstWidth, c.dstHeight); });
+
+            std::cout << (alpha ? "RGBA " : "RGB  ")
+                      << std::setw(5) << c.srcWidth << "x" << std::setw(5) << std::left << c.srcHeight << std::right
+                      << " -> " << std::setw(5) << c.dstWidth << "x" << std::setw(5) << std::left << c.dstHeight << std::right
+                      << std::fixed << std::setprecision(1)
+                      << "  gdk-pixbuf: " << std::setw(7) << gdk << "ms"
+                      << "  scaler: " << std::setw(7) << ours << "ms"
+                      << "  (" << std::setprecision(2) << gdk / ours << "x)" << std::endl;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -27,6 +27,7 @@ SettingsManager::SettingsManager()
         { "StartFullscreen",      false },
         { "StoreRecentFiles",     true  },
         { "SmartNavigation",      false },
+        { "TrustExtensions",      false },
 
         { "BooruBrowserVisible",  true  },
         { "MenuBarVisible",       true  },
@@ -42,6 +43,8 @@ SettingsManager::SettingsManager()
     {
         { "ArchiveIndex",     -1  },
         { "CacheSize",        2   },
+        { "CacheMemory",      512 },
+        { "ThumbnailMemory",  128 },
         { "SlideshowDelay",   5   },
         { "CursorHideDelay",  2   },
         { "TagViewPosition",  560 },
@@ -7,7 +7,8 @@ using namespace AhoViewer;
 
 ThumbnailBar::ThumbnailBar(BaseObjectType *cobj, const Glib::RefPtr<Gtk::Builder> &bldr)
   : Gtk::ScrolledWindow(cobj),
-    m_KeepAligned(true)
+    m_KeepAligned(true),
+    m_ResetValue(0)
 {
     ModelColumns columns;
 
@@ -15,32 +16,46 @@ ThumbnailBar::ThumbnailBar(BaseObjectType *cobj, const Glib::RefPtr<Gtk::Builder
 
     m_VAdjust = Glib::RefPtr<Gtk::Adjustment>::cast_static(bldr->get_object("ThumbnailBar::VAdjust"));
 
-    m_ListStore = Gtk::ListStore::create(columns);
-    m_TreeView->set_model(m_ListStore);
+    m_TreeView->set_model(m_Model);
     m_TreeView->append_column("Thumbnail", columns.pixbuf_column);
     m_TreeView->set_size_request(Image::ThumbnailSize + 9, -1);
+
+    // Every row is as tall as the largest thumbnail,
+    // so the view doesn't have to measure each row of large directories
+    Gtk::TreeViewColumn *column = m_TreeView->get_column(0);
+    column->set_sizing(Gtk::TREE_VIEW_COLUMN_FIXED);
+    column->set_fixed_width(Image::ThumbnailSize + 4);
+    column->get_first_cell_renderer()->set_fixed_size(Image::ThumbnailSize + 4, Image::ThumbnailSize + 4);
+    m_TreeView->set_fixed_height_mode(true);
     m_TreeView->signal_cursor_changed().connect(sigc::mem_fun(*this, &ThumbnailBar::on_cursor_changed));
 
     // If the user scrolls the widget, this will keep scroll_to_selected from being
     // called when thumbnails are being loaded
     m_ScrollConn = get_vadjustment()->signal_value_changed().connect([ this ]() { m_KeepAligned = false; });
+    // This one is never blocked, thumbnail loading follows every scroll
+    get_vadjustment()->signal_value_changed().connect([ this ]() { m_SignalVisibleRangeChanged(); });
 }
 
 void ThumbnailBar::clear()
 {
     ImageList::Widget::clear();
+    m_AlignConn.disconnect();
     m_KeepAligned = true;
 }
 
-void ThumbnailBar::set_pixbuf(const size_t index, const Glib::RefPtr<Gdk::Pixbuf> &pixbuf)
+void ThumbnailBar::row_changed(const size_t index)
 {
     m_ScrollConn.block();
-    ImageList::Widget::set_pixbuf(index, pixbuf);
+    ImageList::Widget::row_changed(index);
     m_ScrollConn.unblock();
 
-    // Keep the selected image centered while thumbnails are being added
-    if (m_KeepAligned)
-        scroll_to_selected();
+    // Keep the selected image centered while thumbnails are being added.
+    // Centering runs the main loop, so it's done once for each batch of thumbnails,
+    // after the rows are resized and before they are drawn.
+    if (m_KeepAligned && !m_AlignConn.connected())
+        m_AlignConn = Glib::signal_idle().connect(
+                sigc::bind_return(sigc::mem_fun(*this, &ThumbnailBar::scroll_to_selected), false),
+                Glib::PRIORITY_HIGH_IDLE + 15);
 }
 
 void ThumbnailBar::on_show()
@@ -51,13 +66,23 @@ void ThumbnailBar::on_show()
 
 void ThumbnailBar::set_selected(const size_t index)
 {
-    Gtk::TreePath path(std::to_string(index));
+    Gtk::TreePath path = get_path(index);
     m_TreeView->get_selection()->select(path);
     scroll_to_selected();
 }
 
+void ThumbnailBar::update_selected(const size_t index)
+{
+    m_TreeView->get_selection()->select(get_path(index));
+
+    if (m_KeepAligned)
+        scroll_to_selected();
+}
+
 void ThumbnailBar::scroll_to_selected()
 {
+    m_AlignConn.disconnect();
+
     if (get_window())
     {
         get_window()->freeze_updates();
@@ -84,6 +109,51 @@ void ThumbnailBar::scroll_to_selected()
     }
 }
 
+void ThumbnailBar::set_model(const Glib::RefPtr<ThumbnailModel> &model)
+{
+    // Replacing the model scrolls the view, that isn't the user scrolling
+    m_ScrollConn.block();
+
+    if (model)
+    {
+        m_TreeView->set_model(model);
+
+        // Restored after the rows are resized and before they are drawn
+        if (!m_KeepAligned)
+        {
+            m_AlignConn.disconnect();
+            m_AlignConn = Glib::signal_idle().connect([ this ]()
+            {
+                m_ScrollConn.block();
+                m_VAdjust->set_value(std::min(m_ResetValue, m_VAdjust->get_upper() - m_VAdjust->get_page_size()));
+                m_ScrollConn.unblock();
+
+                return false;
+            }, Glib::PRIORITY_HIGH_IDLE + 15);
+        }
+    }
+    else
+    {
+        m_ResetValue = m_VAdjust->get_value();
+        m_TreeView->unset_model();
+    }
+
+    m_ScrollConn.unblock();
+}
+
+bool ThumbnailBar::get_visible_range(size_t &start, size_t &end)
+{
+    Gtk::TreePath startPath, endPath;
+
+    if (!m_TreeView->get_realized() || !m_TreeView->get_visible_range(startPath, endPath))
+        return false;
+
+    start = startPath[0];
+    end = endPath[0];
+
+    return true;
+}
+
 void ThumbnailBar::on_cursor_changed()
 {
     Gtk::TreePath path;
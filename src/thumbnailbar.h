@@ -15,19 +15,24 @@ namespace AhoViewer
         virtual ~ThumbnailBar() override = default;
 
         virtual void clear() override;
-        virtual void set_pixbuf(const size_t index, const Glib::RefPtr<Gdk::Pixbuf> &pixbuf) override;
+        virtual void row_changed(const size_t index) override;
     protected:
         virtual void on_show() override;
 
         virtual void set_selected(const size_t index) override;
+        virtual void update_selected(const size_t index) override;
         virtual void scroll_to_selected() override;
+        virtual bool get_visible_range(size_t &start, size_t &end) override;
+        virtual void set_model(const Glib::RefPtr<ThumbnailModel> &model) override;
     private:
         void on_cursor_changed();
 
         Gtk::TreeView *m_TreeView;
         Glib::RefPtr<Gtk::Adjustment> m_VAdjust;
         bool m_KeepAligned;
-        sigc::connection m_ScrollConn;
+        // Scroll position before the model was unset, restored if the user scrolled away
+        double m_ResetValue;
+        sigc::connection m_ScrollConn, m_AlignConn;
     };
 }
 
@@ -0,0 +1,178 @@
+// Measures how fast a thumbnail bar fills when the selection is centered after every
+// thumbnail (what ThumbnailBar did before) and once per batch of thumbnails.
+// Built with `make thumbnailbench`, optionally takes the number of thumbnails (2000 by default).
+// Needs a display, the window is shown while the thumbnails are added.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <gtkmm.h>
+#include <iomanip>
+#include <iostream>
+
+#include "thumbnailmodel.h"
+using namespace AhoViewer;
+
+namespace
+{
+    // Same as ImageList::ThumbnailDrainTime
+    const int DrainTime = 8;
+    const int ThumbnailSize = 100;
+
+    struct ModelColumns : public Gtk::TreeModelColumnRecord
+    {
+        ModelColumns() { add(pixbuf_column); }
+        Gtk::TreeModelColumn<Glib::RefPtr<Gdk::Pixbuf>> pixbuf_column;
+    };
+
+    class Bench
+    {
+    public:
+        Bench(const size_t n, const bool coalesce)
+          : m_Model(ThumbnailModel::create()),
+            m_Size(n),
+            m_Added(0),
+            m_Selected(n / 2),
+            m_Coalesce(coalesce),
+            m_Draining(false)
+        {
+            m_Pixbuf = Gdk::Pixbuf::create(Gdk::COLORSPACE_RGB, true, 8, ThumbnailSize, ThumbnailSize);
+            m_Pixbuf->fill(0x336699ff);
+
+            m_Model->set_pixbuf_func([ this ](const size_t i)
+            {
+                return i < m_Added ? m_Pixbuf : Glib::RefPtr<Gdk::Pixbuf>();
+            });
+            m_Model->reset(m_Size);
+
+            // Set up like ThumbnailBar
+            m_TreeView.set_model(m_Model);
+            m_TreeView.append_column("Thumbnail", m_Columns.pixbuf_column);
+            m_TreeView.set_headers_visible(false);
+            m_TreeView.get_column(0)->set_sizing(Gtk::TREE_VIEW_COLUMN_FIXED);
+            m_TreeView.get_column(0)->set_fixed_width(ThumbnailSize + 4);
+            m_TreeView.get_column(0)->get_first_cell_renderer()->set_fixed_size(ThumbnailSize + 4, ThumbnailSize + 4);
+            m_TreeView.set_fixed_height_mode(true);
+            m_TreeView.get_selection()->select(get_path(m_Selected));
+
+            m_ScrolledWindow.set_policy(Gtk::POLICY_NEVER, Gtk::POLICY_ALWAYS);
+            m_ScrolledWindow.add(m_TreeView);
+            m_Window.add(m_ScrolledWindow);
+            m_Window.set_default_size(ThumbnailSize + 30, 800);
+        }
+
+        // Returns the time it took to add every thumbnail in milliseconds
+        double run()
+        {
+            m_Window.show_all();
+
+            while (Gtk::Main::events_pending())
+                Gtk::Main::iteration();
+
+            auto start = std::chrono::steady_clock::now();
+
+            // Thumbnails arrive faster than they're added, like a directory that's already thumbnailed
+            Glib::signal_idle().connect(sigc::mem_fun(*this, &Bench::drain));
+            Gtk::Main::run();
+
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+    private:
+        static Gtk::TreePath get_path(const size_t index)
+        {
+            Gtk::TreePath path;
+            path.push_back(index);
+            return path;
+        }
+
+        // Adds thumbnails for up to DrainTime like ImageList::drain_thumbnails
+        bool drain()
+        {
+            if (m_Draining)
+                return true;
+
+            m_Draining = true;
+            auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(DrainTime);
+
+            while (m_Added < m_Size && std::chrono::steady_clock::now() < end)
+            {
+                m_Model->changed(m_Added++);
+
+                if (!m_Coalesce)
+                    center();
+                else if (!m_AlignConn.connected())
+                    m_AlignConn = Glib::signal_idle().connect(
+                            sigc::bind_return(sigc::mem_fun(*this, &Bench::center), false),
+                            Glib::PRIORITY_HIGH_IDLE + 15);
+            }
+
+            m_Draining = false;
+
+            if (m_Added < m_Size)
+                return true;
+
+            // Quit once the last centering has run
+            Glib::signal_idle().connect_once([]() { Gtk::Main::quit(); }, Glib::PRIORITY_LOW);
+            return false;
+        }
+
+        // Same as ThumbnailBar::scroll_to_selected
+        void center()
+        {
+            m_AlignConn.disconnect();
+
+            Glib::RefPtr<Gdk::Window> window = m_ScrolledWindow.get_window();
+            Gtk::Adjustment *adjust = m_ScrolledWindow.get_vadjustment();
+            Gdk::Rectangle rect;
+
+            window->freeze_updates();
+
+            while (Gtk::Main::events_pending())
+                Gtk::Main::iteration();
+
+            m_TreeView.get_background_area(get_path(m_Selected), *m_TreeView.get_column(0), rect);
+            double value = adjust->get_value() + rect.get_y() +
+                (rect.get_height() / 2) - (adjust->get_page_size() / 2);
+            adjust->set_value(std::round(std::min(std::max(value, 0.0), adjust->get_upper() - adjust->get_page_size())));
+
+            window->thaw_updates();
+        }
+
+        ModelColumns m_Columns;
+        Gtk::Window m_Window;
+        Gtk::ScrolledWindow m_ScrolledWindow;
+        Gtk::TreeView m_TreeView;
+        Glib::RefPtr<ThumbnailModel> m_Model;
+        Glib::RefPtr<Gdk::Pixbuf> m_Pixbuf;
+        sigc::connection m_AlignConn;
+
+        size_t m_Size, m_Added, m_Selected;
+        bool m_Coalesce, m_Draining;
+    };
+}
+
+int main(int argc, char **argv)
+{
+    Gtk::Main kit(argc, argv);
+
+    const size_t n = argc > 1 ? std::max(std::atol(argv[1]), 1L) : 2000;
+    double each, batched;
+
+    {
+        Bench bench(n, false);
+        each = bench.run();
+    }
+    {
+        Bench bench(n, true);
+        batched = bench.run();
+    }
+
+    std::cout << n << " thumbnails" << std::endl
+              << std::fixed << std::setprecision(1)
+              << "  centered per thumbnail: " << std::setw(8) << each << "ms"
+              << "  (" << n / each * 1000.0 << "/s)" << std::endl
+              << "  centered per batch:     " << std::setw(8) << batched << "ms"
+              << "  (" << n / batched * 1000.0 << "/s, " << each / batched << "x)" << std::endl;
+
+    return EXIT_SUCCESS;
+}
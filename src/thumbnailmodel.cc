@@ -0,0 +1,169 @@
+#include "thumbnailmodel.h"
+using namespace AhoViewer;
+
+Glib::RefPtr<ThumbnailModel> ThumbnailModel::create()
+{
+    return Glib::RefPtr<ThumbnailModel>(new ThumbnailModel());
+}
+
+ThumbnailModel::ThumbnailModel()
+  : Glib::ObjectBase(typeid(ThumbnailModel)),
+    Glib::Object(),
+    m_Stamp(1),
+    m_Size(0)
+{
+
+}
+
+void ThumbnailModel::reset(const size_t size)
+{
+    ++m_Stamp;
+    m_Size = size;
+}
+
+void ThumbnailModel::append(const size_t n)
+{
+    for (size_t i = 0; i < n; ++i)
+        insert(m_Size);
+}
+
+void ThumbnailModel::insert(const size_t index)
+{
+    iterator iter;
+
+    ++m_Stamp;
+    ++m_Size;
+
+    set_iter(index, iter);
+    row_inserted(get_path(index), iter);
+}
+
+void ThumbnailModel::erase(const size_t index)
+{
+    if (index >= m_Size)
+        return;
+
+    ++m_Stamp;
+    --m_Size;
+
+    row_deleted(get_path(index));
+}
+
+void ThumbnailModel::changed(const size_t index)
+{
+    iterator iter;
+
+    if (set_iter(index, iter))
+        row_changed(get_path(index), iter);
+}
+
+Gtk::TreeModelFlags ThumbnailModel::get_flags_vfunc() const
+{
+    return Gtk::TREE_MODEL_LIST_ONLY;
+}
+
+int ThumbnailModel::get_n_columns_vfunc() const
+{
+    return 1;
+}
+
+GType ThumbnailModel::get_column_type_vfunc(int) const
+{
+    return Gdk::Pixbuf::get_type();
+}
+
+void ThumbnailModel::get_value_vfunc(const iterator &iter, int, Glib::ValueBase &value) const
+{
+    Glib::Value<Glib::RefPtr<Gdk::Pixbuf>> v;
+    v.init(Glib::Value<Glib::RefPtr<Gdk::Pixbuf>>::value_type());
+
+    if (iter_is_valid(iter) && m_PixbufFunc)
+        v.set(m_PixbufFunc(get_index(iter)));
+
+    value.init(Glib::Value<Glib::RefPtr<Gdk::Pixbuf>>::value_type());
+    value = v;
+}
+
+bool ThumbnailModel::iter_next_vfunc(const iterator &iter, iterator &iterNext) const
+{
+    return iter_is_valid(iter) && set_iter(get_index(iter) + 1, iterNext);
+}
+
+bool ThumbnailModel::iter_children_vfunc(const iterator&, iterator &iter) const
+{
+    iter = iterator();
+    return false;
+}
+
+bool ThumbnailModel::iter_has_child_vfunc(const iterator&) const
+{
+    return false;
+}
+
+int ThumbnailModel::iter_n_children_vfunc(const iterator&) const
+{
+    return 0;
+}
+
+int ThumbnailModel::iter_n_root_children_vfunc() const
+{
+    return m_Size;
+}
+
+bool ThumbnailModel::iter_nth_child_vfunc(const iterator&, int, iterator &iter) const
+{
+    iter = iterator();
+    return false;
+}
+
+bool ThumbnailModel::iter_nth_root_child_vfunc(int n, iterator &iter) const
+{
+    return n >= 0 && set_iter(n, iter);
+}
+
+bool ThumbnailModel::iter_parent_vfunc(const iterator&, iterator &iter) const
+{
+    iter = iterator();
+    return false;
+}
+
+Gtk::TreeModel::Path ThumbnailModel::get_path_vfunc(const iterator &iter) const
+{
+    return iter_is_valid(iter) ? get_path(get_index(iter)) : Path();
+}
+
+bool ThumbnailModel::get_iter_vfunc(const Path &path, iterator &iter) const
+{
+    return path.size() == 1 && path[0] >= 0 && set_iter(path[0], iter);
+}
+
+bool ThumbnailModel::iter_is_valid(const iterator &iter) const
+{
+    return iter.get_stamp() == m_Stamp && get_index(iter) < m_Size;
+}
+
+bool ThumbnailModel::set_iter(const size_t index, iterator &iter) const
+{
+    if (index >= m_Size)
+    {
+        iter = iterator();
+        return false;
+    }
+
+    iter.set_stamp(m_Stamp);
+    iter.gobj()->user_data = GSIZE_TO_POINTER(index);
+
+    return true;
+}
+
+size_t ThumbnailModel::get_index(const iterator &iter) const
+{
+    return GPOINTER_TO_SIZE(iter.gobj()->user_data);
+}
+
+Gtk::TreeModel::Path ThumbnailModel::get_path(const size_t index) const
+{
+    Path path;
+    path.push_back(index);
+    return path;
+}
@@ -0,0 +1,62 @@
+#ifndef _THUMBNAILMODEL_H_
+#define _THUMBNAILMODEL_H_
+
+#include <functional>
+#include <gtkmm.h>
+
+namespace AhoViewer
+{
+    // A flat list model with a single pixbuf column that stores nothing per row.
+    // The pixbuf of a row is asked for when a view needs it, so adding or removing
+    // rows doesn't depend on how many rows there are.
+    class ThumbnailModel : public Glib::Object,
+                           public Gtk::TreeModel
+    {
+    public:
+        using PixbufFunc = std::function<Glib::RefPtr<Gdk::Pixbuf>(const size_t)>;
+
+        static Glib::RefPtr<ThumbnailModel> create();
+        virtual ~ThumbnailModel() override = default;
+
+        void set_pixbuf_func(const PixbufFunc &func) { m_PixbufFunc = func; }
+        size_t size() const { return m_Size; }
+
+        // Doesn't emit any signals, views need to be given the model again.
+        void reset(const size_t size);
+        void append(const size_t n);
+        void insert(const size_t index);
+        void erase(const size_t index);
+        // The pixbuf of the row at index changed
+        void changed(const size_t index);
+    protected:
+        ThumbnailModel();
+
+        virtual Gtk::TreeModelFlags get_flags_vfunc() const override;
+        virtual int get_n_columns_vfunc() const override;
+        virtual GType get_column_type_vfunc(int index) const override;
+        virtual void get_value_vfunc(const iterator &iter, int column, Glib::ValueBase &value) const override;
+
+        virtual bool iter_next_vfunc(const iterator &iter, iterator &iterNext) const override;
+        virtual bool iter_children_vfunc(const iterator &parent, iterator &iter) const override;
+        virtual bool iter_has_child_vfunc(const iterator &iter) const override;
+        virtual int iter_n_children_vfunc(const iterator &iter) const override;
+        virtual int iter_n_root_children_vfunc() const override;
+        virtual bool iter_nth_child_vfunc(const iterator &parent, int n, iterator &iter) const override;
+        virtual bool iter_nth_root_child_vfunc(int n, iterator &iter) const override;
+        virtual bool iter_parent_vfunc(const iterator &child, iterator &iter) const override;
+        virtual Path get_path_vfunc(const iterator &iter) const override;
+        virtual bool get_iter_vfunc(const Path &path, iterator &iter) const override;
+        virtual bool iter_is_valid(const iterator &iter) const override;
+    private:
+        bool set_iter(const size_t index, iterator &iter) const;
+        size_t get_index(const iterator &iter) const;
+        Path get_path(const size_t index) const;
+
+        // Iters from before a row was added or removed are invalid
+        int m_Stamp;
+        size_t m_Size;
+        PixbufFunc m_PixbufFunc;
+    };
+}
+
+#endif /* _THUMBNAILMODEL_H_ */